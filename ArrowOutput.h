@@ -0,0 +1,280 @@
+// ArrowOutput.h
+// Writes the GenJetsEvent model as Parquet row groups (--format parquet) or
+// as Arrow IPC record batches (--format arrow, the Feather v2 file format),
+// for pandas and coffea without a conversion step.
+//
+// One row per event. eventNum and weight are scalar columns, and the
+// counters nJet, nGen, ... are kept as int32 columns like in the RNTuple.
+// Every written column becomes a list column with the branch name
+// (jet_pt: list<float>, gen_id: list<int32>). Fixed inner dimensions become
+// fixed-size lists, read from the leaflist dims: jet_tau1 [nJet][4] is
+// list<fixed_size_list<float, 4>>, and jet_sdscan_tau1 [nJet][n_points][4]
+// is list<fixed_size_list<fixed_size_list<float, 4>, n_points>>.
+//
+// Each worker fills its own RecordBatchBuilder; every rowGroup events (and
+// at the end) the batch becomes one row group or one record batch of the
+// shared file. Needs the Arrow and Parquet C++ libraries (the Makefile
+// defines GENJETS_HAVE_ARROW when pkg-config finds them).
+
+#ifndef ARROWOUTPUT_H
+#define ARROWOUTPUT_H
+
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "EventRecord.h"
+
+// Row-group size and encoding of the Arrow and Parquet outputs.
+struct ArrowOutputOptions {
+  long rowGroup = 10000;                  // events per row group / record batch
+  std::string compression = "zstd";       // Arrow codec name: zstd, snappy, gzip, lz4, brotli, uncompressed
+  int level = INT_MIN;                    // codec level, INT_MIN = the codec's default
+  bool dictionary = true;                 // Parquet dictionary encoding
+
+  // codec or codec:level
+  bool parseCompression( std::string const & spec ) {
+    auto colon = spec.find( ':' );
+    compression = spec.substr( 0, colon );
+    if ( colon != std::string::npos ) level = std::atoi( spec.c_str() + colon + 1 );
+    return compression != "";
+  }
+};
+
+#ifdef GENJETS_HAVE_ARROW
+#define GENJETS_HAVE_ARROW_OUTPUT 1
+
+#include "arrow/api.h"
+#include "arrow/io/file.h"
+#include "arrow/ipc/writer.h"
+#include "arrow/util/compression.h"
+#include "parquet/arrow/writer.h"
+#include "parquet/properties.h"
+
+class GenJetsArrowFile {
+public:
+  // One worker's handle: appends its record to the builder on fill().
+  class Filler {
+  public:
+    Filler( GenJetsArrowFile & file, GenJetsEvent & rec, std::unique_ptr<arrow::RecordBatchBuilder> builder ) :
+      file_(file), rec_(rec), builder_(std::move(builder))
+    {
+      int ifield = 0;
+      eventNum_ = builder_->GetFieldAs<arrow::UInt64Builder>( ifield++ );
+      weight_ = builder_->GetFieldAs<arrow::DoubleBuilder>( ifield++ );
+      for ( Collection * coll : rec.collections() ) {
+	if ( !coll->enabled() ) continue;
+	counters_.push_back( std::make_pair( coll, builder_->GetFieldAs<arrow::Int32Builder>( ifield++ ) ) );
+	for ( auto const & col : coll->columns() ) {
+	  if ( !col->write() ) continue;
+	  Appender a{ col.get(), coll, builder_->GetFieldAs<arrow::ListBuilder>( ifield++ ), {}, nullptr, nullptr };
+	  arrow::ArrayBuilder * inner = a.list->value_builder();
+	  for ( size_t d = 0; d < fixedDims( *col ).size(); ++d ) {
+	    auto fixed = static_cast<arrow::FixedSizeListBuilder *>( inner );
+	    a.fixed.push_back( fixed );
+	    inner = fixed->value_builder();
+	  }
+	  if ( col->code() == 'F' ) a.floats = static_cast<arrow::FloatBuilder *>( inner );
+	  else a.ints = static_cast<arrow::Int32Builder *>( inner );
+	  appenders_.push_back( a );
+	}
+      }
+    }
+    Filler( Filler const & ) = delete;
+    Filler & operator=( Filler const & ) = delete;
+    ~Filler() { flush(); }
+
+    void fill() {
+      check( eventNum_->Append( rec_.eventNum ) );
+      check( weight_->Append( rec_.weight ) );
+      for ( auto const & c : counters_ ) check( c.second->Append( c.first->size() ) );
+      for ( auto const & a : appenders_ ) {
+	int64_t n = a.coll->size();
+	check( a.list->Append() );
+	for ( auto fixed : a.fixed ) {
+	  check( fixed->AppendValues( n ) );
+	  n *= fixed->list_size();
+	}
+	if ( a.floats ) check( a.floats->AppendValues( static_cast<float const *>( a.col->address() ), n ) );
+	else check( a.ints->AppendValues( static_cast<int32_t const *>( a.col->address() ), n ) );
+      }
+      if ( ++rows_ >= file_.options_.rowGroup ) flush();
+    }
+
+    // Hand the rows filled so far to the file as one row group.
+    void flush() {
+      if ( rows_ == 0 ) return;
+      rows_ = 0;
+      auto batch = builder_->Flush();
+      if ( !batch.ok() ) {
+	check( batch.status() );
+	return;
+      }
+      file_.write( *batch );
+    }
+
+  protected :
+    struct Appender {
+      ColumnBase const * col;
+      Collection const * coll;
+      arrow::ListBuilder * list;
+      std::vector<arrow::FixedSizeListBuilder *> fixed;   // outer to inner
+      arrow::FloatBuilder * floats;
+      arrow::Int32Builder * ints;
+    };
+
+    void check( arrow::Status const & status ) {
+      if ( status.ok() || failed_ ) return;
+      std::cout << "GenJetsArrowFile: " << status.ToString() << std::endl;
+      failed_ = true;
+    }
+
+    GenJetsArrowFile & file_;
+    GenJetsEvent & rec_;
+    std::unique_ptr<arrow::RecordBatchBuilder> builder_;
+    arrow::UInt64Builder * eventNum_;
+    arrow::DoubleBuilder * weight_;
+    std::vector<std::pair<Collection const *, arrow::Int32Builder *> > counters_;
+    std::vector<Appender> appenders_;
+    long rows_ = 0;
+    bool failed_ = false;
+  };
+
+  // parquet = true : Parquet file, otherwise Arrow IPC file.
+  GenJetsArrowFile( std::string const & filename, bool parquet, ArrowOutputOptions const & options ) :
+    filename_(filename), parquet_(parquet), options_(options) {}
+
+  // Thread safe. The first call opens the file with the schema of rec's booked columns.
+  std::unique_ptr<Filler> filler( GenJetsEvent & rec ) {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    if ( !schema_ ) {
+      schema_ = makeSchema( rec );
+      good_ = open();
+    }
+    if ( !good_ ) return nullptr;
+    auto builder = arrow::RecordBatchBuilder::Make( schema_, arrow::default_memory_pool(), options_.rowGroup );
+    if ( !builder.ok() ) {
+      std::cout << "GenJetsArrowFile: " << builder.status().ToString() << std::endl;
+      return nullptr;
+    }
+    return std::unique_ptr<Filler>( new Filler( *this, rec, std::move( *builder ) ) );
+  }
+
+  // Fillers must be gone before this is called; it writes the footer.
+  void close() {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    if ( parquetWriter_ ) report( parquetWriter_->Close() );
+    if ( ipcWriter_ ) report( ipcWriter_->Close() );
+    if ( out_ ) report( out_->Close() );
+    parquetWriter_.reset();
+    ipcWriter_.reset();
+    out_.reset();
+  }
+
+  // Leaflist dims such as "[n_points][4]" as numbers, outer first.
+  static std::vector<int> fixedDims( ColumnBase const & col ) {
+    std::vector<int> dims;
+    std::string s = col.dims();
+    for ( size_t open = s.find( '[' ); open != std::string::npos; open = s.find( '[', open + 1 ) ) dims.push_back( std::atoi( s.c_str() + open + 1 ) );
+    return dims;
+  }
+
+protected :
+  static std::shared_ptr<arrow::Schema> makeSchema( GenJetsEvent & rec ) {
+    std::vector<std::shared_ptr<arrow::Field> > fields;
+    fields.push_back( arrow::field( "eventNum", arrow::uint64() ) );
+    fields.push_back( arrow::field( "weight", arrow::float64() ) );
+    for ( Collection * coll : rec.collections() ) {
+      if ( !coll->enabled() ) continue;
+      fields.push_back( arrow::field( coll->counter(), arrow::int32() ) );
+      for ( auto const & col : coll->columns() ) {
+	if ( !col->write() ) continue;
+	std::shared_ptr<arrow::DataType> type = col->code() == 'F' ? arrow::float32() : arrow::int32();
+	auto dims = fixedDims( *col );
+	for ( auto d = dims.rbegin(); d != dims.rend(); ++d ) type = arrow::fixed_size_list( type, *d );
+	fields.push_back( arrow::field( col->name(), arrow::list( type ) ) );
+      }
+    }
+    return arrow::schema( fields );
+  }
+
+  bool open() {
+    auto out = arrow::io::FileOutputStream::Open( filename_ );
+    auto codec = arrow::util::Codec::GetCompressionType( options_.compression );
+    if ( !out.ok() || !codec.ok() ) {
+      std::cout << "GenJetsArrowFile: cannot write " << filename_ << " with " << options_.compression << ": "
+		<< ( out.ok() ? codec.status() : out.status() ).ToString() << std::endl;
+      return false;
+    }
+    out_ = *out;
+    if ( parquet_ ) {
+      parquet::WriterProperties::Builder props;
+      props.compression( *codec );
+      if ( options_.level != INT_MIN ) props.compression_level( options_.level );
+      if ( options_.dictionary ) props.enable_dictionary();
+      else props.disable_dictionary();
+      props.max_row_group_length( options_.rowGroup );
+      // Keep the Arrow schema, so that the fixed-size lists come back as such.
+      auto arrowProps = parquet::ArrowWriterProperties::Builder().store_schema()->build();
+      auto writer = parquet::arrow::FileWriter::Open( *schema_, arrow::default_memory_pool(), out_, props.build(), arrowProps );
+      if ( !writer.ok() ) return report( writer.status() );
+      parquetWriter_ = std::move( *writer );
+    } else {
+      auto ipcOptions = arrow::ipc::IpcWriteOptions::Defaults();
+      if ( *codec != arrow::Compression::UNCOMPRESSED ) {
+	auto c = arrow::util::Codec::Create( *codec, options_.level == INT_MIN ? arrow::util::kUseDefaultCompressionLevel : options_.level );
+	if ( !c.ok() ) return report( c.status() );
+	ipcOptions.codec = std::move( *c );
+      }
+      auto writer = arrow::ipc::MakeFileWriter( out_, schema_, ipcOptions );
+      if ( !writer.ok() ) return report( writer.status() );
+      ipcWriter_ = *writer;
+    }
+    return true;
+  }
+
+  void write( std::shared_ptr<arrow::RecordBatch> const & batch ) {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    if ( parquetWriter_ ) {
+      auto table = arrow::Table::FromRecordBatches( { batch } );
+      if ( table.ok() ) report( parquetWriter_->WriteTable( **table, batch->num_rows() ) );
+      else report( table.status() );
+    } else if ( ipcWriter_ ) {
+      report( ipcWriter_->WriteRecordBatch( *batch ) );
+    }
+  }
+
+  bool report( arrow::Status const & status ) {
+    if ( !status.ok() ) std::cout << "GenJetsArrowFile: " << filename_ << ": " << status.ToString() << std::endl;
+    return status.ok();
+  }
+
+  std::string filename_;
+  bool parquet_;
+  ArrowOutputOptions options_;
+  std::shared_ptr<arrow::Schema> schema_;
+  bool good_ = false;
+  std::shared_ptr<arrow::io::FileOutputStream> out_;
+  std::unique_ptr<parquet::arrow::FileWriter> parquetWriter_;
+  std::shared_ptr<arrow::ipc::RecordBatchWriter> ipcWriter_;
+  std::mutex mutex_;
+};
+
+#else
+
+// Without the Arrow and Parquet libraries pythia2root refuses --format parquet and arrow.
+class GenJetsArrowFile {
+public:
+  struct Filler { void fill() {} };
+  GenJetsArrowFile( std::string const &, bool, ArrowOutputOptions const & ) {}
+  std::unique_ptr<Filler> filler( GenJetsEvent & ) { return nullptr; }
+  void close() {}
+};
+
+#endif
+
+#endif
@@ -0,0 +1,134 @@
+// AsyncWriter.h
+// Moves the output (TTree::Fill and basket compression, or the RNTuple fill)
+// to its own thread.
+//
+// The generator takes a free event record with acquire(), fills it and
+// hands it over with submit(). The writer thread copies each submitted
+// record into the booked one and calls the fill function. There is a fixed
+// pool of records (two by default, i.e. double buffering), so the generator
+// only waits when all of them are still queued for writing. An acquired
+// record that is not submitted (the event failed the selection) is handed
+// out again by the next acquire().
+
+#ifndef ASYNCWRITER_H
+#define ASYNCWRITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "EventRecord.h"
+
+class AsyncWriter {
+public:
+  AsyncWriter( GenJetsEvent & booked, std::function<void()> fill, unsigned int slots = 2 ) :
+    booked_(booked), fill_(fill)
+  {
+    for ( unsigned int i = 0; i < std::max( 1u, slots ); ++i ) {
+      slots_.emplace_back( new GenJetsEvent( booked.jetNames, booked.nScan, booked.tensors ) );
+      slots_.back()->select( booked.schema );
+      free_.push_back( i );
+    }
+    thread_ = std::thread( [this]() { run(); } );
+  }
+  AsyncWriter( AsyncWriter const & ) = delete;
+  AsyncWriter & operator=( AsyncWriter const & ) = delete;
+  ~AsyncWriter() { finish(); }
+
+  // A record to fill; waits only when every record is queued.
+  GenJetsEvent & acquire() {
+    if ( current_ < 0 ) {
+      auto start = std::chrono::steady_clock::now();
+      std::unique_lock<std::mutex> lock( mutex_ );
+      if ( free_.empty() ) {
+	++nBlocked_;
+	freed_.wait( lock, [this]() { return !free_.empty(); } );
+	blockedSeconds_ += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+      }
+      current_ = free_.front();
+      free_.pop_front();
+    }
+    return *slots_[current_];
+  }
+
+  // Queue the record from the last acquire() for writing.
+  void submit() {
+    {
+      std::lock_guard<std::mutex> lock( mutex_ );
+      queue_.push_back( current_ );
+      ++nSubmitted_;
+      occupancySum_ += queue_.size();
+      maxOccupancy_ = std::max( maxOccupancy_, queue_.size() );
+    }
+    current_ = -1;
+    queued_.notify_one();
+  }
+
+  // Write everything still queued and stop the thread.
+  void finish() {
+    if ( !thread_.joinable() ) return;
+    {
+      std::lock_guard<std::mutex> lock( mutex_ );
+      done_ = true;
+    }
+    queued_.notify_one();
+    thread_.join();
+  }
+
+  void print( std::ostream & out ) const {
+    out << " AsyncWriter: " << nSubmitted_ << " records through " << slots_.size() << " slots" << std::endl;
+    out << "   queue occupancy at submit: mean " << ( nSubmitted_ > 0 ? double(occupancySum_) / nSubmitted_ : 0. )
+	<< ", max " << maxOccupancy_ << std::endl;
+    out << "   generator blocked " << nBlocked_ << " times, " << blockedSeconds_ << " s" << std::endl;
+    out << "   writer busy " << busySeconds_ << " s, idle " << idleSeconds_ << " s" << std::endl;
+  }
+
+protected :
+  void run() {
+    for (;;) {
+      int slot;
+      {
+	auto start = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> lock( mutex_ );
+	queued_.wait( lock, [this]() { return done_ || !queue_.empty(); } );
+	idleSeconds_ += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	if ( queue_.empty() ) return;
+	slot = queue_.front();
+	queue_.pop_front();
+      }
+      auto start = std::chrono::steady_clock::now();
+      booked_.copyFrom( *slots_[slot] );
+      {
+	// The slot is free again as soon as it has been copied.
+	std::lock_guard<std::mutex> lock( mutex_ );
+	free_.push_back( slot );
+      }
+      freed_.notify_one();
+      fill_();
+      busySeconds_ += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    }
+  }
+
+  GenJetsEvent & booked_;
+  std::function<void()> fill_;
+  std::vector<std::unique_ptr<GenJetsEvent> > slots_;
+  std::deque<int> free_, queue_;
+  int current_ = -1;
+  bool done_ = false;
+  std::mutex mutex_;
+  std::condition_variable queued_, freed_;
+  std::thread thread_;
+
+  // Statistics. The blocked ones belong to the generator, busy and idle to the writer thread.
+  unsigned long nSubmitted_ = 0, nBlocked_ = 0;
+  size_t occupancySum_ = 0, maxOccupancy_ = 0;
+  double blockedSeconds_ = 0., busySeconds_ = 0., idleSeconds_ = 0.;
+};
+
+#endif
@@ -0,0 +1,116 @@
+// BatchKinematics.h
+// pt, eta and phi of many particles in one pass.
+//
+// The four-momenta of the particles are first gathered into contiguous
+// px/py/pz/e arrays with add(). compute() then fills pt, eta and phi for
+// all of them in a single loop. The log and atan2 in that loop are written
+// out as branch-free polynomials, so the compiler can vectorize the whole
+// loop. That needs -O3 -fno-math-errno -fno-trapping-math (the CXX_SIMD
+// flags of the Makefile); add -mavx2 -mfma for four doubles per
+// instruction instead of two. Without those flags it is an ordinary scalar
+// loop and gives the same numbers.
+//
+// The results are the floats of Pythia8::Particle::pT(), eta() and phi(),
+// up to a rare difference of one in the last place.
+
+#ifndef BATCHKINEMATICS_H
+#define BATCHKINEMATICS_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+class KinematicsBatch {
+public:
+  void clear() { px.clear(); py.clear(); pz.clear(); e.clear(); index.clear(); }
+  size_t size() const { return px.size(); }
+
+  // Append one four-momentum; index is whatever the caller needs to find the particle again.
+  void add( double px_, double py_, double pz_, double e_, int index_ ) {
+    px.push_back( px_ );
+    py.push_back( py_ );
+    pz.push_back( pz_ );
+    e.push_back( e_ );
+    index.push_back( index_ );
+  }
+
+  // Fill pt, eta and phi for every particle added since clear().
+  void compute() {
+    size_t n = size();
+    pt.resize( n );
+    eta.resize( n );
+    phi.resize( n );
+    kinematics( n, px.data(), py.data(), pz.data(), pt.data(), eta.data(), phi.data() );
+  }
+
+  std::vector<double> px, py, pz, e;
+  std::vector<int> index;
+  std::vector<float> pt, eta, phi;
+
+  // The kernel itself, on plain arrays. eta is computed as in Particle::eta(),
+  // including its cutoff for particles along the beam.
+  static void kinematics( size_t n, double const * __restrict__ px, double const * __restrict__ py,
+			  double const * __restrict__ pz, float * __restrict__ pt,
+			  float * __restrict__ eta, float * __restrict__ phi ) {
+    for ( size_t i = 0; i < n; ++i ) {
+      double pt2 = px[i] * px[i] + py[i] * py[i];
+      double pti = std::sqrt( pt2 );
+      double apz = std::fabs( pz[i] );
+      double abseta = log( ( std::sqrt( pt2 + pz[i] * pz[i] ) + apz ) / max( kTiny, pti ) );
+      pt[i] = pti;
+      eta[i] = pz[i] > 0.0 ? abseta : -abseta;
+      phi[i] = atan2( py[i], px[i] );
+    }
+  }
+
+  // log(y) for finite y > 0. y = 2^k m with m in [sqrt(1/2), sqrt(2)), and
+  // log(m) = 2 atanh(s) with s = (m - 1)/(m + 1), |s| < 0.172.
+  static inline double log( double y ) {
+    uint64_t bits;
+    std::memcpy( &bits, &y, sizeof(bits) );
+    // The exponent as a double without an integer conversion: put the biased
+    // exponent in the mantissa of 2^52 and subtract.
+    uint64_t kbits = ( bits >> 52 ) | 0x4330000000000000ULL;
+    double k;
+    std::memcpy( &k, &kbits, sizeof(k) );
+    k -= 4503599627370496.0 + 1023.0;
+    uint64_t mbits = ( bits & 0x000fffffffffffffULL ) | 0x3ff0000000000000ULL;
+    double m;
+    std::memcpy( &m, &mbits, sizeof(m) );
+    bool big = m > 1.4142135623730951;
+    m = big ? 0.5 * m : m;
+    k = big ? k + 1.0 : k;
+    double s = ( m - 1.0 ) / ( m + 1.0 );
+    double z = s * s;
+    double poly = 1.0 + z * ( 1.0/3 + z * ( 1.0/5 + z * ( 1.0/7 + z * ( 1.0/9 + z * ( 1.0/11 + z * ( 1.0/13 + z * ( 1.0/15 + z * ( 1.0/17 ) ) ) ) ) ) ) );
+    return k * 0.6931471805599453 + 2.0 * s * poly;
+  }
+
+  // atan2(y, x), to about 1e-11. With a = min(|x|,|y|) / max(|x|,|y|) the
+  // angle is reduced to atan(t), |t| <= tan(pi/8), using
+  // atan(a) = pi/4 + atan((a-1)/(a+1)) above tan(pi/8); both cases share one
+  // division. atan(t) is then its Taylor series up to t^27.
+  static inline double atan2( double y, double x ) {
+    double ax = std::fabs( x ), ay = std::fabs( y );
+    double mx = max( ax, ay ), mn = min( ax, ay );
+    bool big = mn > 0.41421356237309503 * mx;
+    double t = ( big ? mn - mx : mn ) / max( kTiny, big ? mn + mx : mx );
+    double z = t * t;
+    double poly = 1.0 - z * ( 1.0/3 - z * ( 1.0/5 - z * ( 1.0/7 - z * ( 1.0/9 - z * ( 1.0/11 - z * ( 1.0/13
+		- z * ( 1.0/15 - z * ( 1.0/17 - z * ( 1.0/19 - z * ( 1.0/21 - z * ( 1.0/23 - z * ( 1.0/25 - z * ( 1.0/27 ) ) ) ) ) ) ) ) ) ) ) ) );
+    double r = t * poly + ( big ? kPi / 4 : 0.0 );
+    r = ay > ax ? kPi / 2 - r : r;
+    r = x < 0.0 ? kPi - r : r;
+    return std::copysign( r, y );
+  }
+
+  // Unlike std::fmax and std::fmin these compile to a single instruction.
+  static inline double max( double a, double b ) { return a > b ? a : b; }
+  static inline double min( double a, double b ) { return a < b ? a : b; }
+
+  static constexpr double kPi = 3.141592653589793;
+  static constexpr double kTiny = 1e-20;                // Pythia's TINY
+};
+
+#endif
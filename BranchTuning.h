@@ -0,0 +1,222 @@
+// BranchTuning.h
+// Compression, basket size and float precision of the output branches, set
+// per group of branches.
+//
+// Every branch falls in one group, by its name:
+//   event          : eventNum, weight and the counters nJet, nGen, ...
+//   kinematics     : *_pt, *_m, *_msd and the other floats not listed below
+//   angles         : *_eta, *_phi
+//   vertices       : *_vxx, *_vyy, *_vzz, *_tau of the particles
+//   nsubjettiness  : jet_tau1 ... jet_tau8, their _sd and _sdscan_ versions
+//   history        : *_mother1/2, *_daughter1/2, *_col
+//   integers       : the other integers: ids, status, flags and indices
+//
+// A preset (--compression fast) sets every group; --branch-compression,
+// --basket-size and --precision then change single groups, e.g.
+//     --compression balanced --branch-compression angles=lz4:4 --precision angles=12,vertices=10
+//
+// A reduced precision keeps that many mantissa bits of the Float_t values:
+// they are rounded before every fill and the lower bits zeroed, so that they
+// compress to almost nothing. The branches stay Float_t. 12 bits are a
+// relative precision of 1.2e-4, 10 bits of 4.9e-4.
+
+#ifndef BRANCHTUNING_H
+#define BRANCHTUNING_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Compression.h"
+#include "TTree.h"
+#include "TBranch.h"
+
+#include "EventRecord.h"
+
+struct BranchSettings {
+  int compression = -1;               // ROOT algorithm * 100 + level, -1 = the file's
+  int basketSize = 0;                 // bytes, 0 = ROOT's default
+  int precision = 0;                  // mantissa bits of floats, 0 = all 23
+};
+
+class BranchTuning {
+public:
+  BranchTuning() { for ( auto const & g : groups() ) settings_[g] = BranchSettings(); }
+
+  static std::vector<std::string> const & groups() {
+    static const std::vector<std::string> names = { "event", "kinematics", "angles", "vertices", "nsubjettiness", "history", "integers" };
+    return names;
+  }
+
+  static std::vector<std::string> const & presets() {
+    static const std::vector<std::string> names = { "default", "fast", "balanced", "archive", "compact" };
+    return names;
+  }
+
+  // The group of a column; code is its leaf type, 'F' or 'I'.
+  static std::string group( std::string const & name, char code ) {
+    auto under = name.rfind( '_' );
+    if ( under == std::string::npos ) return "event";
+    std::string last = name.substr( under + 1 );
+    if ( last == "eta" || last == "phi" ) return "angles";
+    if ( last == "vxx" || last == "vyy" || last == "vzz" || last == "tau" ) return "vertices";
+    if ( name.find( "_tau" ) != std::string::npos ) return "nsubjettiness";
+    if ( last == "mother1" || last == "mother2" || last == "daughter1" || last == "daughter2" || last == "col" ) return "history";
+    return code == 'F' ? "kinematics" : "integers";
+  }
+
+  //   default  : ROOT's compression, full precision
+  //   fast     : LZ4 level 4, cheapest to write and read
+  //   balanced : ZSTD level 5
+  //   archive  : LZMA level 9, smallest and slowest
+  //   compact  : ZSTD level 5, angles kept to 12 and vertices to 10 mantissa bits
+  bool preset( std::string const & name ) {
+    if ( name == "default" ) fileCompression_ = -1;
+    else if ( name == "fast" ) fileCompression_ = ROOT::CompressionSettings( ROOT::RCompressionSetting::EAlgorithm::kLZ4, 4 );
+    else if ( name == "balanced" || name == "compact" ) fileCompression_ = ROOT::CompressionSettings( ROOT::RCompressionSetting::EAlgorithm::kZSTD, 5 );
+    else if ( name == "archive" ) fileCompression_ = ROOT::CompressionSettings( ROOT::RCompressionSetting::EAlgorithm::kLZMA, 9 );
+    else {
+      std::cout << "BranchTuning: unknown preset " << name << ", use default, fast, balanced, archive or compact" << std::endl;
+      return false;
+    }
+    preset_ = name;
+    for ( auto & s : settings_ ) s.second = BranchSettings();
+    for ( auto & s : settings_ ) s.second.compression = fileCompression_;
+    if ( name == "compact" ) {
+      settings_["angles"].precision = 12;
+      settings_["vertices"].precision = 10;
+    }
+    return true;
+  }
+
+  // group=value,... with value an algorithm:level for "compression", bytes for
+  // "basket" and mantissa bits from 1 to 23 (23 = full) for "precision". The group
+  // "all" sets every group.
+  bool parse( std::string const & what, std::string const & list ) {
+    std::stringstream ss( list );
+    std::string item;
+    while ( std::getline( ss, item, ',' ) ) {
+      if ( item == "" ) continue;
+      auto eq = item.find( '=' );
+      std::string g = item.substr( 0, eq );
+      if ( eq == std::string::npos || ( g != "all" && settings_.count( g ) == 0 ) ) {
+	std::cout << "BranchTuning: expected group=value with a group of";
+	for ( auto const & name : groups() ) std::cout << " " << name;
+	std::cout << " or all, not " << item << std::endl;
+	return false;
+      }
+      std::string value = item.substr( eq + 1 );
+      int compression = 0;
+      if ( what == "compression" && !parseCompression( value, compression ) ) return false;
+      char * end = nullptr;
+      long number = std::strtol( value.c_str(), &end, 10 );
+      bool numeric = value != "" && *end == '\0';
+      if ( what == "basket" && !( numeric && number > 0 ) ) {
+	std::cout << "BranchTuning: basket size " << item << " is not a positive number of bytes" << std::endl;
+	return false;
+      }
+      if ( what == "precision" && !( numeric && number >= 1 && number <= 23 ) ) {
+	std::cout << "BranchTuning: precision " << item << " is not a number of mantissa bits from 1 to 23" << std::endl;
+	return false;
+      }
+      for ( auto & s : settings_ ) {
+	if ( g != "all" && s.first != g ) continue;
+	if ( what == "compression" ) s.second.compression = compression;
+	else if ( what == "basket" ) s.second.basketSize = number;
+	else s.second.precision = number < 23 ? number : 0;
+      }
+      if ( what == "compression" && g == "all" ) fileCompression_ = compression;
+    }
+    return true;
+  }
+
+  // zlib, lzma, lz4 or zstd, with an optional :level (default 5), or none.
+  static bool parseCompression( std::string const & spec, int & settings ) {
+    auto colon = spec.find( ':' );
+    std::string name = spec.substr( 0, colon );
+    int level = colon == std::string::npos ? 5 : std::atoi( spec.c_str() + colon + 1 );
+    ROOT::RCompressionSetting::EAlgorithm::EValues algorithm;
+    if ( name == "zlib" ) algorithm = ROOT::RCompressionSetting::EAlgorithm::kZLIB;
+    else if ( name == "lzma" ) algorithm = ROOT::RCompressionSetting::EAlgorithm::kLZMA;
+    else if ( name == "lz4" ) algorithm = ROOT::RCompressionSetting::EAlgorithm::kLZ4;
+    else if ( name == "zstd" ) algorithm = ROOT::RCompressionSetting::EAlgorithm::kZSTD;
+    else if ( name == "none" ) {
+      settings = 0;
+      return true;
+    } else {
+      std::cout << "BranchTuning: unknown compression " << spec << ", use zlib, lzma, lz4, zstd or none, with an optional :level" << std::endl;
+      return false;
+    }
+    settings = ROOT::CompressionSettings( algorithm, level );
+    return true;
+  }
+
+  BranchSettings const & settings( std::string const & g ) const { return settings_.at( g ); }
+
+  // Compression of the file, the RNTuple and the branches of no group; -1 = ROOT's default.
+  int fileCompression() const { return fileCompression_; }
+
+  // Clusters of this many entries (> 0) or bytes (< 0); 0 = ROOT's default.
+  Long64_t autoFlush = 0;
+
+  // Whether any group loses precision, i.e. whether records need reducePrecision().
+  bool lossy() const {
+    for ( auto const & s : settings_ ) if ( s.second.precision > 0 ) return true;
+    return false;
+  }
+
+  // Set the precision of the Float_t columns of rec; call after rec.select().
+  void apply( GenJetsEvent & rec ) const {
+    for ( Collection * coll : rec.collections() ) {
+      for ( auto const & col : coll->columns() ) {
+	if ( col->code() == 'F' ) col->setPrecision( settings_.at( group( col->name(), col->code() ) ).precision );
+      }
+    }
+  }
+
+  // Set the compression and basket sizes of the branches of rec booked (or attached) in T.
+  void apply( GenJetsEvent const & rec, TTree * T ) const {
+    BranchSettings const & event = settings_.at( "event" );
+    for ( auto name : { "eventNum", "weight" } ) tune( T->GetBranch( name ), event );
+    for ( Collection const * coll : rec.collections() ) {
+      if ( !coll->enabled() ) continue;
+      tune( T->GetBranch( coll->counter().c_str() ), event );
+      for ( auto const & col : coll->columns() ) {
+	if ( col->write() ) tune( col->branch(), settings_.at( group( col->name(), col->code() ) ) );
+      }
+    }
+    if ( autoFlush != 0 ) T->SetAutoFlush( autoFlush );
+  }
+
+  void print( std::ostream & out ) const {
+    out << " Branch tuning (" << preset_ << "):";
+    if ( autoFlush != 0 ) out << " auto-flush " << autoFlush;
+    out << std::endl;
+    for ( auto const & g : groups() ) {
+      BranchSettings const & s = settings_.at( g );
+      char buff[1000];
+      sprintf( buff, "   %-14s compression %4s  basket %8s  precision %s", g.c_str(),
+	       s.compression < 0 ? "file" : std::to_string( s.compression ).c_str(),
+	       s.basketSize > 0 ? std::to_string( s.basketSize ).c_str() : "default",
+	       s.precision > 0 ? ( std::to_string( s.precision ) + " bits" ).c_str() : "full" );
+      out << buff << std::endl;
+    }
+  }
+
+protected :
+  static void tune( TBranch * branch, BranchSettings const & s ) {
+    if ( !branch ) return;
+    if ( s.compression >= 0 ) branch->SetCompressionSettings( s.compression );
+    if ( s.basketSize > 0 ) branch->SetBasketSize( s.basketSize );
+  }
+
+  std::map<std::string, BranchSettings> settings_;
+  std::string preset_ = "default";
+  int fileCompression_ = -1;
+};
+
+#endif
@@ -0,0 +1,114 @@
+// Checkpoint.h
+// Periodic checkpoints of a pythia2root run, and resuming from the last one.
+//
+// A checkpoint is taken just before event nextEvent is generated:
+//   1. the tree is flushed with AutoSave, so the file on disk has every
+//      entry so far;
+//   2. Pythia's random-number state is saved to <output>.rndm.<nextEvent>
+//      with Rndm::dumpState();
+//   3. <output>.checkpoint is replaced (written aside, then renamed) by a
+//      small text file with nextEvent, the number of entries, the name of
+//      the random-state file and the weight bookkeeping so far. The
+//      previous random-state file is then removed.
+// Step 3 is atomic, so the last complete checkpoint can always be used. If
+// the job dies between steps 1 and 3, the tree has a few entries more than
+// the checkpoint; the resumed run generates those events again from the
+// same random state and does not fill them a second time.
+//
+// Pythia's cross-section estimate cannot be restored, so every part of the
+// run between a start or resume and the end (or the job dying) is a
+// separate segment, with its own entry in the Runs tree.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "EventWeights.h"
+
+struct Checkpoint {
+  std::string config;                             // config file and seed of the run, to check on resume
+  long seed = -1;
+  uint64_t nextEvent = 0;
+  Long64_t entries = 0;
+  std::string rndmFile;
+  std::vector<WeightSummary> segments;            // finished segments and the current one up to nextEvent
+
+  static std::string filename( std::string const & output ) { return output + ".checkpoint"; }
+
+  bool write( std::string const & filename ) const {
+    std::string tmp = filename + ".tmp";
+    {
+      std::ofstream out( tmp );
+      out.precision( 17 );
+      out << "config " << config << "\n"
+	  << "seed " << seed << "\n"
+	  << "nextEvent " << nextEvent << "\n"
+	  << "entries " << entries << "\n"
+	  << "rndm " << rndmFile << "\n";
+      for ( auto const & s : segments ) {
+	out << "segment " << s.sigmaGen << " " << s.sigmaErr << " " << s.nTried << " " << s.nSelected << " " << s.nAccepted
+	    << " " << s.weightSum << " " << s.unweightTarget << " " << s.nConsidered << " " << s.nKept << " " << s.nOverweight
+	    << " " << s.sumWeights << " " << s.sumStored << " " << s.maxWeight << "\n";
+      }
+      out.flush();
+      if ( !out ) {
+	std::cout << "Checkpoint: cannot write " << tmp << std::endl;
+	return false;
+      }
+    }
+    if ( std::rename( tmp.c_str(), filename.c_str() ) != 0 ) {
+      std::cout << "Checkpoint: cannot rename " << tmp << " to " << filename << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  bool read( std::string const & filename ) {
+    std::ifstream in( filename );
+    if ( !in ) {
+      std::cout << "Checkpoint: cannot read " << filename << std::endl;
+      return false;
+    }
+    segments.clear();
+    std::string line;
+    while ( std::getline( in, line ) ) {
+      std::istringstream ss( line );
+      std::string key;
+      ss >> key;
+      if ( key == "config" ) std::getline( ss >> std::ws, config );
+      else if ( key == "seed" ) ss >> seed;
+      else if ( key == "nextEvent" ) ss >> nextEvent;
+      else if ( key == "entries" ) ss >> entries;
+      else if ( key == "rndm" ) ss >> rndmFile;
+      else if ( key == "segment" ) {
+	WeightSummary s;
+	ss >> s.sigmaGen >> s.sigmaErr >> s.nTried >> s.nSelected >> s.nAccepted
+	   >> s.weightSum >> s.unweightTarget >> s.nConsidered >> s.nKept >> s.nOverweight
+	   >> s.sumWeights >> s.sumStored >> s.maxWeight;
+	segments.push_back( s );
+      }
+    }
+    if ( rndmFile == "" ) {
+      std::cout << "Checkpoint: " << filename << " is incomplete" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // Remove the checkpoint files once the run has finished.
+  static void remove( std::string const & filename ) {
+    Checkpoint last;
+    std::ifstream in( filename );
+    if ( in && last.read( filename ) ) std::remove( last.rndmFile.c_str() );
+    std::remove( filename.c_str() );
+  }
+};
+
+#endif
@@ -0,0 +1,88 @@
+// CommonOptions.h
+// The command line that pythia2root and mpt2root share:
+//     program [options] config_file root_file n_events [seed] ...
+// parse() takes the options below; each program handles its own options
+// and any positional arguments after the seed.
+
+#ifndef COMMONOPTIONS_H
+#define COMMONOPTIONS_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "JetCollections.h"
+#include "SoftDropScan.h"
+
+struct CommonOptions {
+  std::string configfile;
+  std::string outfile;
+  unsigned int nEvents = 0;
+  long seed = -1;                      // -1 = Pythia's default, 0 = from the time
+  unsigned long reportEvery = 1000;    // events between progress lines, 0 = none
+  std::string statsFile;               // JSON run summary, default root_file.stats.json
+  std::vector<JetSpec> jets;           // jet collections; empty = the program's default
+  std::vector<GroomingPoint> sdScan;   // extra SoftDrop points for the _sdscan_ branches
+  bool eventSeeds = false;             // random numbers of each event from seed and eventNum only
+  unsigned long firstEvent = 0;        // eventNum of the first event, to generate one shard of a sample
+  std::string initCacheDir;            // reuse the MPI initialization from files in this directory
+  unsigned int pipelineSlots = 0;      // > 0 : run the stages of the event loop on their own threads
+
+  // If argv[i] is a common option, consume it (and its value) and return true.
+  // ok is set to false if the value is malformed.
+  bool parse( int & i, int argc, char ** argv, bool & ok ) {
+    std::string arg( argv[i] );
+    bool value = i + 1 < argc;
+    if ( arg == "--report-every" && value ) {
+      reportEvery = atol( argv[++i] );
+    } else if ( arg == "--stats" && value ) {
+      statsFile = argv[++i];
+    } else if ( arg == "--jets" && value ) {
+      jets = JetSpec::parse( argv[++i] );
+      ok = !jets.empty();
+    } else if ( arg == "--sd-scan" && value ) {
+      ok = GroomingPoint::parse( argv[++i], sdScan );
+    } else if ( arg == "--event-seeds" ) {
+      eventSeeds = true;
+    } else if ( arg == "--first-event" && value ) {
+      firstEvent = atol( argv[++i] );
+    } else if ( arg == "--init-cache" && value ) {
+      initCacheDir = argv[++i];
+    } else if ( arg == "--pipeline" && value ) {
+      pipelineSlots = std::max( 0, atoi( argv[++i] ) );
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  // config_file root_file n_events [seed], with the options already stripped; false if too few.
+  bool positional( std::vector<char *> const & args ) {
+    if ( args.size() < 4 ) return false;
+    configfile = args[1];
+    outfile = args[2];
+    nEvents = atol( args[3] );
+    if ( args.size() > 4 ) seed = atol( args[4] );
+    if ( statsFile == "" ) statsFile = outfile + ".stats.json";
+    return true;
+  }
+
+  // With --event-seeds all workers and shards use one base seed; the Pythia default
+  // (-1) and time-based (0) seeds are made explicit and printed so that events can be replayed.
+  void resolveEventSeed() {
+    if ( !eventSeeds ) return;
+    if ( seed < 0 ) seed = 19780503;                // Pythia's default Random:seed
+    else if ( seed == 0 ) seed = std::time(nullptr);
+    std::cout << "Per-event random streams from base seed " << seed << ", first event " << firstEvent << std::endl;
+  }
+
+  static std::string usage() {
+    return "[--report-every n] [--stats file.json] [--jets prefix:alg:R:ptmin,...] [--sd-scan z:b,...] "
+      "[--event-seeds] [--first-event k] [--init-cache dir] [--pipeline slots]";
+  }
+};
+
+#endif
@@ -0,0 +1,657 @@
+// EventRecord.h
+// Structure-of-arrays event record behind the output trees.
+//
+// Every jagged branch is a Column. The Columns of one Collection share the
+// counter (nJet, nGen, ...) that ROOT uses as the leaflist length. Column
+// storage only grows: it keeps its capacity from event to event, and
+// clear() just resets the counter. When push() has to grow the storage,
+// the branch addresses are refreshed by sync(), which must be called
+// before each Fill().
+
+#ifndef EVENTRECORD_H
+#define EVENTRECORD_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Pythia8/Pythia.h"
+#include "TTree.h"
+#include "TBranch.h"
+
+#include "BatchKinematics.h"
+#include "OutputSchema.h"
+#include "ParticleCache.h"
+
+// ROOT leaf type code and fixed inner dimension of a column entry.
+template<class T> struct LeafType;
+template<> struct LeafType<Float_t> { static const char code = 'F'; static const unsigned int dim = 1; };
+template<> struct LeafType<Int_t>   { static const char code = 'I'; static const unsigned int dim = 1; };
+template<class T, size_t N> struct LeafType< std::array<T,N> > {
+  static const char code = LeafType<T>::code;
+  static const unsigned int dim = N;
+};
+
+// Round n floats to bits mantissa bits (1 to 22) and zero the bits below, which
+// then compress to almost nothing. Infinities and NaNs are left alone.
+inline void roundMantissa( float * values, size_t n, int bits ) {
+  const uint32_t shift = 23 - bits;
+  const uint32_t mask = ~( ( uint32_t(1) << shift ) - 1 );
+  const uint32_t half = uint32_t(1) << ( shift - 1 );
+  for ( size_t i = 0; i < n; ++i ) {
+    uint32_t u;
+    std::memcpy( &u, values + i, sizeof(u) );
+    if ( ( u & 0x7F800000 ) == 0x7F800000 ) continue;
+    u = ( u + half ) & mask;            // a carry into the exponent is still the nearest value
+    std::memcpy( values + i, &u, sizeof(u) );
+  }
+}
+
+class ColumnBase {
+public:
+  ColumnBase( std::string const & name, bool write ) : name_(name), write_(write) {}
+  virtual ~ColumnBase() {}
+
+  virtual void grow( size_t capacity ) = 0;
+  virtual void * address() = 0;
+  virtual void const * address() const = 0;
+  virtual char code() const = 0;
+  // Bytes of one entry, including the fixed inner dimensions.
+  virtual size_t entryBytes() const = 0;
+  // Fixed inner dimensions of an entry in leaflist form, e.g. "[4]", or "" for a scalar.
+  virtual std::string dims() const = 0;
+  // Copy the first n entries of other, a column of the same type.
+  virtual void copy( ColumnBase const & other, size_t n ) = 0;
+  // Move entry i of the first n to remap[i], or drop it if remap[i] < 0. remap[i] <= i.
+  virtual void compact( std::vector<Int_t> const & remap, size_t n ) = 0;
+
+  std::string const & name() const { return name_; }
+  bool write() const { return write_; }
+  void setWrite( bool write ) { write_ = write; }
+  TBranch * branch() const { return branch_; }
+  void setBranch( TBranch * branch ) { branch_ = branch; }
+  // Mantissa bits kept when the values are written, 0 = all (Float_t columns only).
+  int precision() const { return precision_; }
+  void setPrecision( int bits ) { precision_ = bits > 0 && bits < 23 && code() == 'F' ? bits : 0; }
+
+protected :
+  std::string name_;
+  bool write_;
+  TBranch * branch_ = nullptr;
+  int precision_ = 0;
+};
+
+template<class T>
+class Column : public ColumnBase {
+public:
+  Column( std::string const & name, bool write ) : ColumnBase(name, write) {}
+
+  T & operator[]( size_t i ) { return data_[i]; }
+  T const & operator[]( size_t i ) const { return data_[i]; }
+  T * data() { return data_.data(); }
+  T const * data() const { return data_.data(); }
+
+  void grow( size_t capacity ) override { data_.resize( capacity ); }
+  void * address() override { return data_.data(); }
+  void const * address() const override { return data_.data(); }
+  char code() const override { return LeafType<T>::code; }
+  size_t entryBytes() const override { return sizeof(T); }
+  std::string dims() const override { return LeafType<T>::dim > 1 ? "[" + std::to_string( LeafType<T>::dim ) + "]" : ""; }
+  void copy( ColumnBase const & other, size_t n ) override {
+    auto const & o = static_cast<Column<T> const &>( other );
+    std::copy( o.data_.begin(), o.data_.begin() + n, data_.begin() );
+  }
+  void compact( std::vector<Int_t> const & remap, size_t n ) override {
+    for ( size_t i = 0; i < n; ++i ) if ( remap[i] >= 0 ) data_[remap[i]] = data_[i];
+  }
+
+protected :
+  std::vector<T> data_;
+};
+
+// A column whose entries are rows of a width fixed at run time, e.g. one value
+// per SoftDrop grooming point: row i starts at (*this)[i].
+template<class T>
+class RowColumn : public ColumnBase {
+public:
+  RowColumn( std::string const & name, bool write, size_t width ) : ColumnBase(name, write), width_(width) {}
+
+  T * operator[]( size_t i ) { return data_.data() + i * width_; }
+  T const * operator[]( size_t i ) const { return data_.data() + i * width_; }
+  size_t width() const { return width_; }
+
+  void grow( size_t capacity ) override { data_.resize( capacity * width_ ); }
+  void * address() override { return data_.data(); }
+  void const * address() const override { return data_.data(); }
+  char code() const override { return LeafType<T>::code; }
+  size_t entryBytes() const override { return width_ * sizeof(T); }
+  std::string dims() const override {
+    return "[" + std::to_string( width_ ) + "]" + ( LeafType<T>::dim > 1 ? "[" + std::to_string( LeafType<T>::dim ) + "]" : "" );
+  }
+  void copy( ColumnBase const & other, size_t n ) override {
+    auto const & o = static_cast<RowColumn<T> const &>( other );
+    std::copy( o.data_.begin(), o.data_.begin() + n * width_, data_.begin() );
+  }
+  void compact( std::vector<Int_t> const & remap, size_t n ) override {
+    for ( size_t i = 0; i < n; ++i ) {
+      if ( remap[i] >= 0 ) std::copy( (*this)[i], (*this)[i] + width_, (*this)[remap[i]] );
+    }
+  }
+
+protected :
+  size_t width_;
+  std::vector<T> data_;
+};
+
+// Columns sharing one counter branch.
+class Collection {
+public:
+  Collection( std::string const & counter, size_t capacity ) : counter_(counter), capacity_(capacity) {}
+  Collection( Collection const & ) = delete;
+  Collection & operator=( Collection const & ) = delete;
+
+  // Add a column; write = false keeps it in memory only (e.g. bookkeeping indices).
+  template<class T> Column<T> & add( std::string const & name, bool write = true ) {
+    auto col = new Column<T>( name, write );
+    col->grow( capacity_ );
+    columns_.emplace_back( col );
+    return *col;
+  }
+  template<class T> RowColumn<T> & addRows( std::string const & name, size_t width, bool write = true ) {
+    auto col = new RowColumn<T>( name, write, width );
+    col->grow( capacity_ );
+    columns_.emplace_back( col );
+    return *col;
+  }
+
+  // Make room for one more entry in every column and return its index.
+  Int_t push() {
+    if ( size_t(n_) == capacity_ ) {
+      capacity_ *= 2;
+      for ( auto & col : columns_ ) col->grow( capacity_ );
+      moved_ = true;
+    }
+    return n_++;
+  }
+
+  void clear() { n_ = 0; }
+  Int_t size() const { return n_; }
+
+  // Take over the contents of o, a collection with the same columns.
+  void copyFrom( Collection const & o ) {
+    if ( capacity_ < size_t(o.n_) ) {
+      capacity_ = o.capacity_;
+      for ( auto & col : columns_ ) col->grow( capacity_ );
+      moved_ = true;
+    }
+    n_ = o.n_;
+    for ( size_t i = 0; i < columns_.size(); ++i ) columns_[i]->copy( *o.columns_[i], n_ );
+  }
+
+  // Keep the entries i with remap[i] >= 0, as entry remap[i]; the kept entries
+  // must stay in order, numbered 0, 1, ...
+  void compact( std::vector<Int_t> const & remap ) {
+    Int_t n = 0;
+    for ( Int_t i = 0; i < n_; ++i ) if ( remap[i] >= 0 ) ++n;
+    if ( n == n_ ) return;
+    for ( auto & col : columns_ ) col->compact( remap, n_ );
+    n_ = n;
+  }
+
+  bool enabled() const { return enabled_; }
+  void setEnabled( bool enabled ) { enabled_ = enabled; }
+  size_t capacity() const { return capacity_; }
+  std::string const & counter() const { return counter_; }
+  std::vector<std::unique_ptr<ColumnBase> > const & columns() const { return columns_; }
+
+  // Counter branch first, then "name[counter]/F"-style leaflists.
+  void book( TTree * T ) {
+    if ( !enabled_ ) return;
+    T->Branch( counter_.c_str(), &n_, (counter_ + "/I").c_str() );
+    for ( auto & col : columns_ ) {
+      if ( !col->write() ) continue;
+      std::string leaflist = col->name() + "[" + counter_ + "]" + col->dims() + "/" + col->code();
+      col->setBranch( T->Branch( col->name().c_str(), col->address(), leaflist.c_str() ) );
+    }
+    moved_ = false;
+  }
+
+  // Point the branches of a tree booked by book() in an earlier run at the storage,
+  // e.g. to append to it. Returns false if a branch is missing.
+  bool attach( TTree * T ) {
+    if ( !enabled_ ) return true;
+    TBranch * counter = T->GetBranch( counter_.c_str() );
+    if ( !counter ) return false;
+    counter->SetAddress( &n_ );
+    for ( auto & col : columns_ ) {
+      if ( !col->write() ) continue;
+      TBranch * branch = T->GetBranch( col->name().c_str() );
+      if ( !branch ) return false;
+      branch->SetAddress( col->address() );
+      col->setBranch( branch );
+    }
+    moved_ = false;
+    return true;
+  }
+
+  // Round the entries of the columns with a reduced precision; call before writing.
+  void reducePrecision() {
+    if ( !enabled_ ) return;
+    for ( auto & col : columns_ ) {
+      if ( col->write() && col->precision() > 0 ) {
+	roundMantissa( static_cast<float *>( col->address() ), n_ * col->entryBytes() / sizeof(float), col->precision() );
+      }
+    }
+  }
+
+  // Point the branches at the storage again if push() reallocated it.
+  void sync() {
+    if ( !moved_ ) return;
+    for ( auto & col : columns_ ) {
+      if ( col->branch() ) col->branch()->SetAddress( col->address() );
+    }
+    moved_ = false;
+  }
+
+protected :
+  std::string counter_;
+  Int_t n_ = 0;
+  size_t capacity_;
+  bool moved_ = false;
+  bool enabled_ = true;
+  std::vector<std::unique_ptr<ColumnBase> > columns_;
+};
+
+// Pythia particles, as in the gen_* and constituent_* branches.
+// The history and vertex columns can be switched off; they are then not filled either.
+struct ParticleColumns : public Collection {
+  ParticleColumns( std::string const & prefix, std::string const & counter, size_t capacity = 1024 ) :
+    Collection( counter, capacity ),
+    orig      ( add<Int_t>  ( prefix + "_orig", false ) ),
+    pt        ( add<Float_t>( prefix + "_pt" ) ),
+    eta       ( add<Float_t>( prefix + "_eta" ) ),
+    phi       ( add<Float_t>( prefix + "_phi" ) ),
+    m         ( add<Float_t>( prefix + "_m" ) ),
+    flags     ( add<Int_t>  ( prefix + "_flags" ) ),
+    id        ( add<Int_t>  ( prefix + "_id" ) ),
+    status    ( add<Int_t>  ( prefix + "_status" ) ),
+    mother1   ( add<Int_t>  ( prefix + "_mother1" ) ),
+    mother2   ( add<Int_t>  ( prefix + "_mother2" ) ),
+    daughter1 ( add<Int_t>  ( prefix + "_daughter1" ) ),
+    daughter2 ( add<Int_t>  ( prefix + "_daughter2" ) ),
+    col       ( add<Int_t>  ( prefix + "_col" ) ),
+    vxx       ( add<Float_t>( prefix + "_vxx" ) ),
+    vyy       ( add<Float_t>( prefix + "_vyy" ) ),
+    vzz       ( add<Float_t>( prefix + "_vzz" ) ),
+    tau       ( add<Float_t>( prefix + "_tau" ) )
+  {}
+
+  void select( bool history, bool vertices ) {
+    history_ = history;
+    vertices_ = vertices;
+    for ( ColumnBase * c : { &mother1, &mother2, &daughter1, &daughter2, &col } ) c->setWrite( history );
+    for ( ColumnBase * c : { &vxx, &vyy, &vzz, &tau } ) c->setWrite( vertices );
+  }
+
+  // Append p, found at index i of the Pythia event record. With kinematics = false
+  // pt, eta and phi are left to setKinematics().
+  Int_t push( Pythia8::Particle const & p, int i, bool kinematics = true ) {
+    Int_t k = Collection::push();
+    if ( kinematics ) {
+      pt[k] = p.pT();
+      eta[k] = p.eta();
+      phi[k] = p.phi();
+    }
+    m[k] = p.m();
+    orig[k] = i;
+    id[k] =         p.id();
+    flags[k] =      particleFlags( p );
+    status[k] =     p.status();
+    if ( history_ ) {
+      mother1[k] =    p.mother1();
+      mother2[k] =    p.mother2();
+      daughter1[k] =  p.daughter1();
+      daughter2[k] =  p.daughter2();
+      col[k] =        p.col();
+    }
+    if ( vertices_ ) {
+      vxx[k] =        p.xProd();
+      vyy[k] =        p.yProd();
+      vzz[k] =        p.zProd();
+      tau[k] =        p.tau();
+    }
+    return k;
+  }
+
+  // Append a particle read back from a ParticleCache. The cache has no history
+  // or vertices, so those columns must be switched off with select().
+  Int_t push( CachedParticle const & p, bool kinematics = true ) {
+    Int_t k = Collection::push();
+    if ( kinematics ) {
+      Pythia8::Vec4 v( p.px, p.py, p.pz, p.e );
+      pt[k] = v.pT();
+      eta[k] = v.eta();
+      phi[k] = v.phi();
+    }
+    m[k] = p.m;
+    orig[k] = p.index;
+    id[k] = p.id;
+    flags[k] = p.flags;
+    status[k] = p.status;
+    return k;
+  }
+
+  // Fill pt, eta and phi of the entries from first on, one per particle of a computed batch.
+  void setKinematics( KinematicsBatch const & batch, Int_t first = 0 ) {
+    std::copy( batch.pt.begin(), batch.pt.end(), pt.data() + first );
+    std::copy( batch.eta.begin(), batch.eta.end(), eta.data() + first );
+    std::copy( batch.phi.begin(), batch.phi.end(), phi.data() + first );
+  }
+
+  Column<Int_t>   & orig;        // original index for debugging, not written
+  Column<Float_t> & pt;
+  Column<Float_t> & eta;
+  Column<Float_t> & phi;
+  Column<Float_t> & m;
+  Column<Int_t>   & flags;
+  Column<Int_t>   & id;
+  Column<Int_t>   & status;
+  Column<Int_t>   & mother1;
+  Column<Int_t>   & mother2;
+  Column<Int_t>   & daughter1;
+  Column<Int_t>   & daughter2;
+  Column<Int_t>   & col;
+  Column<Float_t> & vxx;
+  Column<Float_t> & vyy;
+  Column<Float_t> & vzz;
+  Column<Float_t> & tau;
+
+protected :
+  bool history_ = true;
+  bool vertices_ = true;
+};
+
+// Particles that can end up in jets, with the jet and subjet they were clustered into.
+struct ConstituentColumns : public ParticleColumns {
+  ConstituentColumns( std::string const & prefix, std::string const & counter, size_t capacity = 2048 ) :
+    ParticleColumns( prefix, counter, capacity ),
+    jetndx    ( add<Int_t>( prefix + "_jetndx" ) ),
+    subjetndx ( add<Int_t>( prefix + "_subjetndx" ) )
+  {}
+
+  Int_t push( Pythia8::Particle const & p, int i, bool kinematics = true ) {
+    Int_t k = ParticleColumns::push( p, i, kinematics );
+    jetndx[k] =     -1; // set later
+    subjetndx[k] =  -1; // set later
+    return k;
+  }
+
+  Int_t push( CachedParticle const & p, bool kinematics = true ) {
+    Int_t k = ParticleColumns::push( p, kinematics );
+    jetndx[k] =     -1; // set later
+    subjetndx[k] =  -1; // set later
+    return k;
+  }
+
+  Column<Int_t> & jetndx;
+  Column<Int_t> & subjetndx;
+};
+
+// Sizes of the per-jet ML tensors made by JetTensors.h; 0 = not written.
+struct TensorShape {
+  size_t npix = 0;                                // jet image of npix x npix pixels
+  size_t ncloud = 0;                              // particle cloud of the ncloud leading constituents
+};
+
+// Groomed and ungroomed jets with N-subjettiness and the two leading SoftDrop subjets.
+// The constituent indices of all jets are concatenated, jet by jet, in a second
+// collection: jet i owns nic[i] consecutive entries of ic. nic[i] is nc[i], its
+// number of constituents, unless the constituents were skimmed.
+// With nScan > 0 the groomed quantities are also kept for each point of a
+// SoftDrop scan, in the <prefix>_sdscan_* columns with one row entry per point.
+// With a TensorShape the jet image is kept in <prefix>_image, one row of
+// npix * npix pixels per jet, and the particle cloud in <prefix>_cloud, one
+// row of ncloud (deta, dphi, pt, e) entries per jet.
+struct JetColumns : public Collection {
+  static const unsigned int kMaxNsj = 8;          // tau_1 ... tau_8
+  static const unsigned int kNsjBeta = 4;         // Various tau beta values
+  typedef std::array<Float_t, kNsjBeta> TauRow;
+  typedef TauRow CloudRow;                        // deta, dphi, pt, e; the same type keeps the RNTuple binding
+
+  // Groomed jet quantities of every scan point; rows are indexed by the point.
+  struct ScanColumns {
+    RowColumn<Float_t> * msd = nullptr;
+    RowColumn<Int_t>   * nsubjet = nullptr;
+    std::array<RowColumn<Float_t> *, 4> subjet0;  // pt, eta, phi, m
+    std::array<RowColumn<Float_t> *, 4> subjet1;
+    std::array<RowColumn<TauRow> *, kMaxNsj> tau; // tau[N-1][ijet][ipoint][ibeta]
+  };
+
+  JetColumns( std::string const & prefix, std::string const & counter, size_t nScan = 0, TensorShape tensors = TensorShape(), size_t capacity = 16 ) :
+    Collection( counter, capacity ),
+    pt         ( add<Float_t>( prefix + "_pt" ) ),
+    eta        ( add<Float_t>( prefix + "_eta" ) ),
+    phi        ( add<Float_t>( prefix + "_phi" ) ),
+    m          ( add<Float_t>( prefix + "_m" ) ),
+    msd        ( add<Float_t>( prefix + "_msd" ) ),
+    tau        ( addTaus( prefix + "_tau", "" ) ),
+    tau_sd     ( addTaus( prefix + "_tau", "_sd" ) ),
+    nc         ( add<Int_t>  ( prefix + "_nc" ) ),
+    nic        ( add<Int_t>  ( prefix + "_nic" ) ),
+    nsubjet    ( add<Int_t>  ( prefix + "_nsubjet" ) ),
+    subjet0_pt ( add<Float_t>( prefix + "_subjet0_pt" ) ),
+    subjet0_eta( add<Float_t>( prefix + "_subjet0_eta" ) ),
+    subjet0_phi( add<Float_t>( prefix + "_subjet0_phi" ) ),
+    subjet0_m  ( add<Float_t>( prefix + "_subjet0_m" ) ),
+    subjet1_pt ( add<Float_t>( prefix + "_subjet1_pt" ) ),
+    subjet1_eta( add<Float_t>( prefix + "_subjet1_eta" ) ),
+    subjet1_phi( add<Float_t>( prefix + "_subjet1_phi" ) ),
+    subjet1_m  ( add<Float_t>( prefix + "_subjet1_m" ) ),
+    ics        ( counter + "Constituent", 256 ),
+    ic         ( ics.add<Int_t>( prefix + "_ic" ) ),
+    nScan      ( nScan )
+  {
+    if ( tensors.npix > 0 ) image = &addRows<Float_t>( prefix + "_image", tensors.npix * tensors.npix );
+    if ( tensors.ncloud > 0 ) cloud = &addRows<CloudRow>( prefix + "_cloud", tensors.ncloud );
+    if ( nScan == 0 ) return;
+    std::string stem = prefix + "_sdscan_";
+    sdscan.msd = &addRows<Float_t>( stem + "msd", nScan );
+    sdscan.nsubjet = &addRows<Int_t>( stem + "nsubjet", nScan );
+    std::array<std::string, 4> const kinematics = { "pt", "eta", "phi", "m" };
+    for ( unsigned int k = 0; k < 4; ++k ) {
+      sdscan.subjet0[k] = &addRows<Float_t>( stem + "subjet0_" + kinematics[k], nScan );
+      sdscan.subjet1[k] = &addRows<Float_t>( stem + "subjet1_" + kinematics[k], nScan );
+    }
+    for ( unsigned int N = 1; N <= kMaxNsj; ++N ) sdscan.tau[N-1] = &addRows<TauRow>( stem + "tau" + std::to_string(N), nScan );
+  }
+
+  // N-subjettiness, subjet and constituent-index columns can be switched off.
+  void select( bool nsubjettiness, bool subjets, bool constituents ) {
+    for ( unsigned int N = 1; N <= kMaxNsj; ++N ) {
+      tau[N-1]->setWrite( nsubjettiness );
+      tau_sd[N-1]->setWrite( nsubjettiness );
+    }
+    for ( ColumnBase * c : std::initializer_list<ColumnBase *>{ &nsubjet, &subjet0_pt, &subjet0_eta, &subjet0_phi, &subjet0_m,
+	  &subjet1_pt, &subjet1_eta, &subjet1_phi, &subjet1_m } ) c->setWrite( subjets );
+    nic.setWrite( constituents );
+    ics.setEnabled( constituents );
+    if ( nScan == 0 ) return;
+    for ( unsigned int N = 1; N <= kMaxNsj; ++N ) sdscan.tau[N-1]->setWrite( nsubjettiness );
+    sdscan.nsubjet->setWrite( subjets );
+    for ( unsigned int k = 0; k < 4; ++k ) {
+      sdscan.subjet0[k]->setWrite( subjets );
+      sdscan.subjet1[k]->setWrite( subjets );
+    }
+  }
+
+  void book( TTree * T ) { Collection::book( T ); ics.book( T ); }
+  bool attach( TTree * T ) { return Collection::attach( T ) && ics.attach( T ); }
+  void clear() { Collection::clear(); ics.clear(); }
+  void sync() { Collection::sync(); ics.sync(); }
+
+  Column<Float_t> & pt;
+  Column<Float_t> & eta;
+  Column<Float_t> & phi;
+  Column<Float_t> & m;
+  Column<Float_t> & msd;
+  std::array<Column<TauRow> *, kMaxNsj> tau;     // tau[N-1][ijet][ibeta]
+  std::array<Column<TauRow> *, kMaxNsj> tau_sd;
+  Column<Int_t>   & nc;
+  Column<Int_t>   & nic;                          // entries of ic owned by each jet
+  Column<Int_t>   & nsubjet;
+  Column<Float_t> & subjet0_pt;
+  Column<Float_t> & subjet0_eta;
+  Column<Float_t> & subjet0_phi;
+  Column<Float_t> & subjet0_m;
+  Column<Float_t> & subjet1_pt;
+  Column<Float_t> & subjet1_eta;
+  Column<Float_t> & subjet1_phi;
+  Column<Float_t> & subjet1_m;
+  Collection ics;
+  Column<Int_t>   & ic;
+  size_t const nScan;                             // SoftDrop scan points
+  ScanColumns sdscan;                             // only with nScan > 0
+  RowColumn<Float_t>  * image = nullptr;          // image[ijet][ieta * npix + iphi], only with a TensorShape
+  RowColumn<CloudRow> * cloud = nullptr;          // cloud[ijet][iconstituent][ifeature]
+
+protected :
+  std::array<Column<TauRow> *, kMaxNsj> addTaus( std::string const & stem, std::string const & suffix ) {
+    std::array<Column<TauRow> *, kMaxNsj> cols;
+    for ( unsigned int N = 1; N <= kMaxNsj; ++N ) cols[N-1] = &add<TauRow>( stem + std::to_string(N) + suffix );
+    return cols;
+  }
+};
+
+// Everything pythia2root writes for one event. There is one JetColumns per jet
+// collection, given as (prefix, counter) pairs; jets is the first of them, and
+// constituent_jetndx and constituent_subjetndx refer to it. Every collection
+// has the same number of SoftDrop scan points and the same tensor shape.
+struct GenJetsEvent {
+  typedef std::vector<std::pair<std::string, std::string> > JetNames;
+
+  explicit GenJetsEvent( JetNames const & names = { { "jet", "nJet" } }, size_t nScan = 0, TensorShape tensors = TensorShape() ) :
+    jetNames(names), nScan(nScan), tensors(tensors), jetCollections(makeJets(names, nScan, tensors)), jets(*jetCollections[0])
+  {}
+  GenJetsEvent( GenJetsEvent const & ) = delete;
+  GenJetsEvent & operator=( GenJetsEvent const & ) = delete;
+
+  ULong64_t eventNum = 0;                         // need to store an event number for uproot access
+  Double_t weight = 1.;                           // Pythia event weight, or the unweighting target
+  JetNames const jetNames;
+  size_t const nScan;
+  TensorShape const tensors;
+  std::vector<std::unique_ptr<JetColumns> > const jetCollections;
+  JetColumns & jets;
+  ParticleColumns gen{ "gen", "nGen" };
+  ConstituentColumns constituents{ "constituent", "nConstituent" };
+  OutputSchema schema;
+
+  // Choose the branch groups; call before book().
+  void select( OutputSchema const & s ) {
+    schema = s;
+    for ( auto & jc : jetCollections ) jc->select( schema.nsubjettiness, schema.subjets, schema.constituents );
+    gen.select( schema.history, schema.vertices );
+    constituents.select( schema.history, schema.vertices );
+    constituents.subjetndx.setWrite( schema.subjets );
+    constituents.setEnabled( schema.constituents );
+  }
+
+  void book( TTree * T ) {
+    T->Branch("eventNum",    &eventNum,  "eventNum/l");
+    T->Branch("weight",      &weight,    "weight/D");
+    for ( auto & jc : jetCollections ) jc->book( T );
+    gen.book( T );
+    constituents.book( T );
+  }
+  // Continue filling a tree booked with the same jet collections and schema.
+  bool attach( TTree * T ) {
+    for ( auto name : { "eventNum", "weight" } ) if ( !T->GetBranch( name ) ) return false;
+    T->GetBranch( "eventNum" )->SetAddress( &eventNum );
+    T->GetBranch( "weight" )->SetAddress( &weight );
+    for ( auto & jc : jetCollections ) if ( !jc->attach( T ) ) return false;
+    return gen.attach( T ) && constituents.attach( T );
+  }
+  // Every collection, in booking order, for writers other than TTree.
+  std::vector<Collection *> collections() {
+    std::vector<Collection *> all;
+    for ( auto & jc : jetCollections ) { all.push_back( jc.get() ); all.push_back( &jc->ics ); }
+    all.push_back( &gen );
+    all.push_back( &constituents );
+    return all;
+  }
+  std::vector<Collection const *> collections() const {
+    auto all = const_cast<GenJetsEvent *>( this )->collections();
+    return std::vector<Collection const *>( all.begin(), all.end() );
+  }
+
+  void copyFrom( GenJetsEvent const & o ) {
+    eventNum = o.eventNum;
+    weight = o.weight;
+    auto to = collections();
+    auto from = o.collections();
+    for ( size_t i = 0; i < to.size(); ++i ) to[i]->copyFrom( *from[i] );
+  }
+
+  void clear() {
+    for ( auto & jc : jetCollections ) jc->clear();
+    gen.clear();
+    constituents.clear();
+  }
+  void sync() {
+    for ( auto & jc : jetCollections ) jc->sync();
+    gen.sync();
+    constituents.sync();
+  }
+  // Keep only the constituents of the stored jets of every collection, with pt >= ptmin,
+  // and point jet_ic at their new entries. constituent_jetndx and _subjetndx move with
+  // them. Constituents below ptmin are also taken out of jet_ic, and jet_nic then
+  // counts the ones that are left; jet_nc keeps the number of constituents.
+  void skimConstituents( float ptmin ) {
+    Int_t n = constituents.size();
+    skimRemap_.assign( n, -1 );
+    for ( auto & jc : jetCollections ) {
+      for ( Int_t k = 0; k < jc->ics.size(); ++k ) skimRemap_[ jc->ic[k] ] = 0;
+    }
+    Int_t kept = 0;
+    for ( Int_t i = 0; i < n; ++i ) skimRemap_[i] = skimRemap_[i] == 0 && constituents.pt[i] >= ptmin ? kept++ : -1;
+    constituents.compact( skimRemap_ );
+    for ( auto & jc : jetCollections ) {
+      icRemap_.assign( jc->ics.size(), -1 );
+      Int_t k = 0, first = 0;
+      for ( Int_t ijet = 0; ijet < jc->size(); ++ijet ) {
+	Int_t nic = 0;
+	for ( Int_t j = first; j < first + jc->nic[ijet]; ++j ) {
+	  jc->ic[j] = skimRemap_[ jc->ic[j] ];
+	  if ( jc->ic[j] >= 0 ) icRemap_[j] = k + nic++;
+	}
+	first += jc->nic[ijet];
+	jc->nic[ijet] = nic;
+	k += nic;
+      }
+      jc->ics.compact( icRemap_ );
+    }
+  }
+
+  // Apply the column precisions set by BranchTuning to this event.
+  void reducePrecision() {
+    for ( Collection * coll : collections() ) coll->reducePrecision();
+  }
+
+protected :
+  std::vector<Int_t> skimRemap_;                  // old to new constituent entries, -1 = dropped
+  std::vector<Int_t> icRemap_;
+
+  static std::vector<std::unique_ptr<JetColumns> > makeJets( JetNames const & names, size_t nScan, TensorShape tensors ) {
+    std::vector<std::unique_ptr<JetColumns> > jcs;
+    for ( auto const & name : names ) jcs.emplace_back( new JetColumns( name.first, name.second, nScan, tensors ) );
+    return jcs;
+  }
+};
+
+#endif
@@ -0,0 +1,510 @@
+// EventRing.h
+// Ring buffer of events in POSIX shared memory: one producer (pythia2root
+// --shm name) and up to kMaxRingConsumers consumers on the same machine,
+// which see each event as it is written, without a file.
+//
+// Layout of the shared memory object /name (native byte order):
+//   EventRingHeader
+//   schema                             text, header.schemaBytes
+//   nSlots x ( EventRingSlot, slotBytes of payload )
+// An event payload is eventNum (uint64), weight (double), then for every
+// collection of the schema its counter (int32) and, column by column, that
+// many entries. The schema has a line "@counter" per collection, followed
+// by a line "name code entryBytes dims" per column, with the code and the
+// dims of the ROOT leaflist, so the payload mirrors the jet_*, gen_* and
+// constituent_* branches. All entries are 4-byte floats or ints, so every
+// column is 4-byte aligned.
+//
+// The shared memory is never locked. Event pos goes to slot pos % nSlots. The slot's
+// sequence number is odd while the producer writes it and 2 (pos + 1) once
+// it is complete; a consumer copies the payload and checks the sequence
+// number again, so an event overwritten while it was read is skipped, never
+// returned half-written. Each consumer publishes the position it has read
+// up to. What the producer does when the slowest live consumer is a whole
+// ring behind is the policy:
+//   block       wait for it (consumers whose process is gone are dropped)
+//   drop        drop the new event
+//   overwrite   write anyway; the slow consumer loses the oldest events
+// A consumer starts at the next event written after it attaches. Several
+// threads of the producer process (the --threads workers) may publish; a
+// mutex in EventRingWriter makes them one producer.
+
+#ifndef EVENTRING_H
+#define EVENTRING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const unsigned int kMaxRingConsumers = 16;
+static const char kEventRingMagic[8] = { 'G', 'J', 'R', 'I', 'N', 'G', '0', '1' };
+static const uint32_t kEventRingVersion = 1;
+
+static_assert( std::atomic<uint64_t>::is_always_lock_free && std::atomic<int32_t>::is_always_lock_free,
+	       "EventRing needs lock-free atomics to share them between processes" );
+
+struct EventRingConsumer {
+  std::atomic<int32_t> pid;             // 0 = free, -1 = being attached
+  std::atomic<uint64_t> readPos;        // events before this one have been read
+};
+
+struct EventRingHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t policy;
+  uint64_t nSlots;
+  uint64_t slotBytes;                   // payload bytes per slot
+  uint64_t schemaBytes;
+  std::atomic<uint32_t> ready;          // the schema is written
+  std::atomic<uint32_t> closed;         // the producer is done
+  std::atomic<uint64_t> writePos;       // events written so far
+  std::atomic<uint64_t> dropped;        // events dropped by the policy or for their size
+  EventRingConsumer consumers[kMaxRingConsumers];
+};
+
+struct EventRingSlot {
+  std::atomic<uint64_t> seq;
+  uint64_t bytes;
+};
+
+inline size_t eventRingSlotStride( uint64_t slotBytes ) { return sizeof(EventRingSlot) + ( slotBytes + 7 ) / 8 * 8; }
+inline size_t eventRingBytes( EventRingHeader const & h ) {
+  return sizeof(EventRingHeader) + ( h.schemaBytes + 7 ) / 8 * 8 + h.nSlots * eventRingSlotStride( h.slotBytes );
+}
+
+class EventRingWriter {
+public:
+  enum Policy { kBlock, kDrop, kOverwrite };
+
+  static bool parsePolicy( std::string const & name, Policy & policy ) {
+    if ( name == "block" ) policy = kBlock;
+    else if ( name == "drop" ) policy = kDrop;
+    else if ( name == "overwrite" ) policy = kOverwrite;
+    else {
+      std::cout << "EventRing: unknown policy " << name << ", use block, drop or overwrite" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // Create /name, replacing a ring left over from an earlier run.
+  EventRingWriter( std::string const & name, uint64_t nSlots, uint64_t slotBytes, Policy policy, uint64_t schemaBytes = 1 << 16 ) :
+    name_(name), policy_(policy)
+  {
+    ::shm_unlink( name.c_str() );
+    int fd = ::shm_open( name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600 );
+    EventRingHeader h;
+    h.nSlots = nSlots;
+    h.slotBytes = slotBytes;
+    h.schemaBytes = schemaBytes;
+    bytes_ = eventRingBytes( h );
+    if ( fd < 0 || nSlots == 0 || ::ftruncate( fd, bytes_ ) != 0 ) {
+      std::cout << "EventRingWriter: cannot create shared memory " << name << ": " << std::strerror( errno ) << std::endl;
+      if ( fd >= 0 ) ::close( fd );
+      return;
+    }
+    void * data = ::mmap( nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if ( data == MAP_FAILED ) {
+      std::cout << "EventRingWriter: cannot map " << name << std::endl;
+      return;
+    }
+    // The object is zero-filled, which is a valid state for every atomic.
+    base_ = static_cast<char *>( data );
+    header_ = reinterpret_cast<EventRingHeader *>( base_ );
+    header_->version = kEventRingVersion;
+    header_->policy = policy;
+    header_->nSlots = nSlots;
+    header_->slotBytes = slotBytes;
+    header_->schemaBytes = schemaBytes;
+    // The magic goes last: readers wait for it before trusting the rest of the header.
+    std::atomic_thread_fence( std::memory_order_release );
+    std::memcpy( header_->magic, kEventRingMagic, sizeof(header_->magic) );
+  }
+  EventRingWriter( EventRingWriter const & ) = delete;
+  EventRingWriter & operator=( EventRingWriter const & ) = delete;
+  ~EventRingWriter() { close(); }
+
+  bool good() const { return header_ != nullptr; }
+
+  // The schema of a GenJetsEvent (or anything with collections()), after select().
+  template<class Record>
+  static std::string describe( Record const & rec ) {
+    std::ostringstream schema;
+    for ( auto coll : rec.collections() ) {
+      if ( !coll->enabled() ) continue;
+      schema << "@" << coll->counter() << "\n";
+      for ( auto const & col : coll->columns() ) {
+	if ( col->write() ) schema << col->name() << " " << col->code() << " " << col->entryBytes() << " " << col->dims() << "\n";
+      }
+    }
+    return schema.str();
+  }
+
+  // Set the schema once; later calls (e.g. from the other workers) must give the same one.
+  bool setSchema( std::string const & schema ) {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    if ( !header_ ) return false;
+    if ( header_->ready.load( std::memory_order_acquire ) ) return schema == schema_;
+    if ( schema.size() + 1 > header_->schemaBytes ) {
+      std::cout << "EventRingWriter: schema of " << schema.size() << " bytes does not fit" << std::endl;
+      return false;
+    }
+    schema_ = schema;
+    std::memcpy( base_ + sizeof(EventRingHeader), schema.c_str(), schema.size() + 1 );
+    header_->ready.store( 1, std::memory_order_release );
+    return true;
+  }
+
+  // Encode rec and publish it. Thread safe; false if the event was dropped.
+  template<class Record>
+  bool publish( Record const & rec ) {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    buffer_.clear();
+    put( &rec.eventNum, sizeof(uint64_t) );
+    put( &rec.weight, sizeof(double) );
+    for ( auto coll : rec.collections() ) {
+      if ( !coll->enabled() ) continue;
+      int32_t n = coll->size();
+      put( &n, sizeof(n) );
+      for ( auto const & col : coll->columns() ) {
+	if ( col->write() ) put( col->address(), n * col->entryBytes() );
+      }
+    }
+    return publishLocked( buffer_.data(), buffer_.size() );
+  }
+
+  // Publish an encoded event. Thread safe; false if the event was dropped.
+  bool publish( void const * data, size_t bytes ) {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    return publishLocked( data, bytes );
+  }
+
+  // Tell the consumers that no more events come and remove the name; attached consumers can still drain the ring.
+  void close() {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    if ( !header_ ) return;
+    header_->closed.store( 1, std::memory_order_release );
+    ::munmap( base_, bytes_ );
+    ::shm_unlink( name_.c_str() );
+    header_ = nullptr;
+    base_ = nullptr;
+  }
+
+  void print( std::ostream & out ) const {
+    static const char * policies[] = { "block", "drop", "overwrite" };
+    char buff[1000];
+    sprintf( buff, " Shared memory %s (%s): %lu events published, %lu dropped (%lu too large), %.3f s blocked",
+	     name_.c_str(), policies[policy_], published_, dropped_, oversized_, blockedSeconds_ );
+    out << buff << std::endl;
+  }
+
+protected :
+  void put( void const * data, size_t bytes ) {
+    char const * p = static_cast<char const *>( data );
+    buffer_.insert( buffer_.end(), p, p + bytes );
+  }
+
+  EventRingSlot * slot( uint64_t pos ) const {
+    char * slots = base_ + sizeof(EventRingHeader) + ( header_->schemaBytes + 7 ) / 8 * 8;
+    return reinterpret_cast<EventRingSlot *>( slots + ( pos % header_->nSlots ) * eventRingSlotStride( header_->slotBytes ) );
+  }
+
+  // True if a live consumer has not yet read the event that writing pos would overwrite.
+  bool full( uint64_t pos, bool reap ) const {
+    bool isFull = false;
+    for ( auto & c : header_->consumers ) {
+      int32_t pid = c.pid.load( std::memory_order_acquire );
+      if ( pid <= 0 ) continue;
+      if ( pos < c.readPos.load( std::memory_order_acquire ) + header_->nSlots ) continue;
+      if ( reap && ::kill( pid, 0 ) != 0 && errno == ESRCH ) {
+	c.pid.compare_exchange_strong( pid, 0 );
+	continue;
+      }
+      isFull = true;
+    }
+    return isFull;
+  }
+
+  bool publishLocked( void const * data, size_t bytes ) {
+    if ( !header_ ) return false;
+    if ( bytes > header_->slotBytes ) {
+      ++oversized_;
+      ++dropped_;
+      header_->dropped.fetch_add( 1, std::memory_order_relaxed );
+      return false;
+    }
+    uint64_t pos = header_->writePos.load( std::memory_order_relaxed );
+    if ( policy_ != kOverwrite && full( pos, false ) ) {
+      if ( policy_ == kDrop ) {
+	// A consumer that died without detaching would keep the ring full for good,
+	// so every 64th drop checks that the consumers holding it up are still alive.
+	if ( dropped_ % 64 != 0 || full( pos, true ) ) {
+	  ++dropped_;
+	  header_->dropped.fetch_add( 1, std::memory_order_relaxed );
+	  return false;
+	}
+      } else {
+	auto start = std::chrono::steady_clock::now();
+	for ( unsigned int i = 1; full( pos, i % 1000 == 0 ); ++i ) std::this_thread::sleep_for( std::chrono::microseconds( 20 ) );
+	blockedSeconds_ += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+      }
+    }
+    EventRingSlot * s = slot( pos );
+    s->seq.store( 2 * pos + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+    s->bytes = bytes;
+    std::memcpy( reinterpret_cast<char *>( s + 1 ), data, bytes );
+    s->seq.store( 2 * ( pos + 1 ), std::memory_order_release );
+    header_->writePos.store( pos + 1, std::memory_order_release );
+    ++published_;
+    return true;
+  }
+
+  std::string name_;
+  Policy policy_;
+  size_t bytes_ = 0;
+  char * base_ = nullptr;
+  EventRingHeader * header_ = nullptr;
+  std::string schema_;
+  std::vector<char> buffer_;
+  unsigned long published_ = 0, dropped_ = 0, oversized_ = 0;
+  double blockedSeconds_ = 0.;
+  std::mutex mutex_;
+};
+
+// One event read from the ring; valid until the next EventRingReader::next().
+class EventRingEvent {
+public:
+  uint64_t eventNum = 0;
+  double weight = 0.;
+
+  // Entries of column name; n is set to the collection's counter (entries of
+  // entryBytes each). Null if the ring has no such column.
+  template<class T>
+  T const * column( std::string const & name, int & n ) const {
+    n = 0;
+    if ( !index_ ) return nullptr;
+    auto icol = index_->find( name );
+    if ( icol == index_->end() ) return nullptr;
+    n = counts_[(*columns_)[icol->second].collection];
+    return reinterpret_cast<T const *>( buffer_.data() + offsets_[icol->second] );
+  }
+
+protected :
+  friend class EventRingReader;
+  struct ColumnInfo {
+    std::string name;
+    char code;
+    size_t entryBytes;
+    size_t collection;
+  };
+
+  // Walk the payload in buffer_ and find where every column starts.
+  bool decode( std::vector<ColumnInfo> const & columns, size_t nCollections, std::unordered_map<std::string, size_t> const & index ) {
+    if ( buffer_.size() < 16 ) return false;
+    std::memcpy( &eventNum, buffer_.data(), 8 );
+    std::memcpy( &weight, buffer_.data() + 8, 8 );
+    columns_ = &columns;
+    index_ = &index;
+    counts_.assign( nCollections, 0 );
+    offsets_.resize( columns.size() );
+    size_t at = 16, i = 0;
+    for ( size_t icoll = 0; icoll < nCollections; ++icoll ) {
+      if ( at + 4 > buffer_.size() ) return false;
+      std::memcpy( &counts_[icoll], buffer_.data() + at, 4 );
+      at += 4;
+      for ( ; i < columns.size() && columns[i].collection == icoll; ++i ) {
+	offsets_[i] = at;
+	at += counts_[icoll] * columns[i].entryBytes;
+      }
+      if ( at > buffer_.size() ) return false;
+    }
+    return true;
+  }
+
+  std::vector<char> buffer_;
+  std::vector<ColumnInfo> const * columns_ = nullptr;
+  std::unordered_map<std::string, size_t> const * index_ = nullptr;
+  std::vector<int32_t> counts_;
+  std::vector<size_t> offsets_;
+};
+
+class EventRingReader {
+public:
+  // Attach to /name as one of the consumers; waits up to timeoutSeconds for the producer and its schema.
+  explicit EventRingReader( std::string const & name, double timeoutSeconds = 10. ) {
+    auto start = std::chrono::steady_clock::now();
+    // The producer creates the object, then sizes it, then writes the header; a
+    // consumer started first may see any of those steps, so it retries them all.
+    std::string problem;
+    while ( ( problem = map( name ) ) != "" && elapsed( start ) < timeoutSeconds )
+      std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    if ( problem != "" ) {
+      std::cout << "EventRingReader: " << problem << std::endl;
+      return;
+    }
+    EventRingHeader * h = reinterpret_cast<EventRingHeader *>( base_ );
+    while ( !h->ready.load( std::memory_order_acquire ) && elapsed( start ) < timeoutSeconds )
+      std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    if ( !h->ready.load( std::memory_order_acquire ) ) {
+      std::cout << "EventRingReader: no schema in " << name << std::endl;
+      return;
+    }
+    for ( auto & c : h->consumers ) {
+      int32_t free = 0;
+      if ( !c.pid.compare_exchange_strong( free, -1 ) ) continue;
+      consumer_ = &c;
+      break;
+    }
+    if ( !consumer_ ) {
+      std::cout << "EventRingReader: " << name << " already has " << kMaxRingConsumers << " consumers" << std::endl;
+      return;
+    }
+    header_ = h;
+    pos_ = header_->writePos.load( std::memory_order_acquire );
+    consumer_->readPos.store( pos_, std::memory_order_release );
+    consumer_->pid.store( ::getpid(), std::memory_order_release );
+    parseSchema( std::string( base_ + sizeof(EventRingHeader) ) );
+  }
+  EventRingReader( EventRingReader const & ) = delete;
+  EventRingReader & operator=( EventRingReader const & ) = delete;
+  ~EventRingReader() {
+    if ( consumer_ ) consumer_->pid.store( 0, std::memory_order_release );
+    if ( base_ ) ::munmap( base_, bytes_ );
+  }
+
+  bool good() const { return header_ != nullptr; }
+
+  // Read the next event into ev. False once the producer has closed the ring and
+  // everything is read, after timeoutSeconds (< 0: no limit) without an event,
+  // or after interrupt().
+  bool next( EventRingEvent & ev, double timeoutSeconds = -1. ) {
+    if ( !header_ ) return false;
+    auto start = std::chrono::steady_clock::now();
+    for (;;) {
+      if ( interrupted_.load( std::memory_order_relaxed ) ) return false;
+      uint64_t written = header_->writePos.load( std::memory_order_acquire );
+      if ( pos_ < written ) {
+	if ( written - pos_ > header_->nSlots ) {
+	  // Lapped by the producer (overwrite policy).
+	  lost_ += written - header_->nSlots - pos_;
+	  pos_ = written - header_->nSlots;
+	}
+	EventRingSlot * s = slot( pos_ );
+	uint64_t seq = s->seq.load( std::memory_order_acquire );
+	if ( seq == 2 * ( pos_ + 1 ) ) {
+	  size_t bytes = std::min<uint64_t>( s->bytes, header_->slotBytes );
+	  ev.buffer_.resize( bytes );
+	  std::memcpy( ev.buffer_.data(), reinterpret_cast<char const *>( s + 1 ), bytes );
+	  std::atomic_thread_fence( std::memory_order_acquire );
+	  if ( s->seq.load( std::memory_order_relaxed ) == seq ) {
+	    consumer_->readPos.store( ++pos_, std::memory_order_release );
+	    if ( ev.decode( columns_, nCollections_, index_ ) ) return true;
+	    ++lost_;                    // malformed; should not happen
+	    continue;
+	  }
+	}
+	// Overwritten while we looked: the next pass skips ahead.
+	continue;
+      }
+      if ( header_->closed.load( std::memory_order_acquire ) ) return false;
+      if ( timeoutSeconds >= 0 && elapsed( start ) > timeoutSeconds ) return false;
+      std::this_thread::sleep_for( std::chrono::microseconds( 20 ) );
+    }
+  }
+
+  // Make a waiting next() return false; safe to call from a signal handler.
+  void interrupt() { interrupted_.store( true, std::memory_order_relaxed ); }
+
+  // Events this consumer missed because the producer overwrote them.
+  uint64_t lost() const { return lost_; }
+  // Events the producer dropped, for all consumers.
+  uint64_t dropped() const { return header_ ? header_->dropped.load( std::memory_order_relaxed ) : 0; }
+  std::vector<std::string> columns() const {
+    std::vector<std::string> names;
+    for ( auto const & c : columns_ ) names.push_back( c.name );
+    return names;
+  }
+
+protected :
+  // Map /name if it is a complete ring; otherwise unmap it again and say what is missing.
+  std::string map( std::string const & name ) {
+    int fd = ::shm_open( name.c_str(), O_RDWR, 0 );
+    struct stat st;
+    if ( fd < 0 || ::fstat( fd, &st ) != 0 || size_t(st.st_size) < sizeof(EventRingHeader) ) {
+      if ( fd >= 0 ) ::close( fd );
+      return "cannot open shared memory " + name;
+    }
+    void * data = ::mmap( nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if ( data == MAP_FAILED ) return "cannot map " + name;
+    EventRingHeader * h = static_cast<EventRingHeader *>( data );
+    bool complete = std::memcmp( h->magic, kEventRingMagic, sizeof(h->magic) ) == 0;
+    std::atomic_thread_fence( std::memory_order_acquire );
+    if ( !complete || h->version != kEventRingVersion || eventRingBytes( *h ) > size_t(st.st_size) ) {
+      ::munmap( data, st.st_size );
+      return name + " is not an event ring of version " + std::to_string( kEventRingVersion );
+    }
+    base_ = static_cast<char *>( data );
+    bytes_ = st.st_size;
+    return "";
+  }
+
+  static double elapsed( std::chrono::steady_clock::time_point start ) {
+    return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+  }
+
+  EventRingSlot * slot( uint64_t pos ) const {
+    char * slots = base_ + sizeof(EventRingHeader) + ( header_->schemaBytes + 7 ) / 8 * 8;
+    return reinterpret_cast<EventRingSlot *>( slots + ( pos % header_->nSlots ) * eventRingSlotStride( header_->slotBytes ) );
+  }
+
+  void parseSchema( std::string const & schema ) {
+    std::istringstream in( schema );
+    std::string line;
+    while ( std::getline( in, line ) ) {
+      if ( line.empty() ) continue;
+      if ( line[0] == '@' ) {
+	++nCollections_;
+	continue;
+      }
+      std::istringstream fields( line );
+      EventRingEvent::ColumnInfo c;
+      fields >> c.name >> c.code >> c.entryBytes;
+      c.collection = nCollections_ - 1;
+      index_[c.name] = columns_.size();
+      columns_.push_back( c );
+    }
+  }
+
+  char * base_ = nullptr;
+  size_t bytes_ = 0;
+  EventRingHeader * header_ = nullptr;
+  EventRingConsumer * consumer_ = nullptr;
+  uint64_t pos_ = 0;
+  uint64_t lost_ = 0;
+  std::atomic<bool> interrupted_{ false };
+  std::vector<EventRingEvent::ColumnInfo> columns_;
+  std::unordered_map<std::string, size_t> index_;
+  size_t nCollections_ = 0;
+};
+
+#endif
@@ -0,0 +1,58 @@
+// EventSeeds.h
+// Random numbers that depend only on a base seed and the event number.
+//
+// Pythia normally draws every event from one random stream, so event k can
+// only be reproduced by generating events 0 ... k-1 first. EventRandom
+// replaces Pythia's generator (setRndmEnginePtr) by a counter-based one:
+// before each pythia.next() the caller does setEvent(eventNum), and the
+// random numbers of that event are then
+//     mix( start + i * gamma ),   i = 1, 2, ...
+// with start = mix( key(base) + mix(eventNum) ) and mix the SplitMix64
+// finalizer. Each event thus has its own stream, fixed by (base, eventNum),
+// so any event or range of events can be generated on its own, shards can
+// run in any order, and the output does not depend on the number of
+// threads. Streams of different events overlap only if their starts are
+// closer than the number of draws, about 1e-12 for a pair of events.
+//
+// Pythia still adapts some phase-space maxima during a run. An event
+// generated on its own matches the same event of a full run unless such a
+// maximum was raised by an earlier event of that run.
+
+#ifndef EVENTSEEDS_H
+#define EVENTSEEDS_H
+
+#include <cstdint>
+
+#include "Pythia8/Pythia.h"
+
+class EventRandom : public Pythia8::RndmEngine {
+public:
+  static const uint64_t kInitEvent = ~uint64_t(0);   // stream used by pythia.init()
+
+  explicit EventRandom( uint64_t base ) : key_( mix( base ) ) { setEvent( kInitEvent ); }
+
+  void setEvent( uint64_t eventNum ) { state_ = mix( key_ + mix( eventNum ) ); }
+
+  // Uniform in (0, 1), as Pythia expects.
+  double flat() override {
+    double x;
+    do {
+      state_ += kGamma;
+      x = ( mix( state_ ) >> 11 ) * ( 1.0 / 9007199254740992.0 );
+    } while ( x == 0. );
+    return x;
+  }
+
+  static uint64_t mix( uint64_t z ) {
+    z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+    return z ^ ( z >> 31 );
+  }
+
+protected :
+  static const uint64_t kGamma = 0x9e3779b97f4a7c15ULL;
+  uint64_t key_;
+  uint64_t state_ = 0;
+};
+
+#endif
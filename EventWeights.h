@@ -0,0 +1,147 @@
+// EventWeights.h
+// Event weights of biased samples and on-the-fly unweighting.
+//
+// With PhaseSpace:bias2Selection (the qcd_flat*, zz_flat* configs) every
+// event carries the weight info.weight(); it is written to the weight
+// branch. An Unweighter with a target weight W turns such a sample into
+// an unweighted one while it is generated: an event of weight w, |w| < W,
+// is kept with probability |w| / W and then stores W (with the sign of w).
+// Events with |w| >= W are always kept with their own weight and counted
+// as overweight. Rejected events are dropped right after generation, so
+// they cost no clustering, substructure or output.
+//
+// The cross-section bookkeeping of each worker is written to the tree
+// "Runs" of the output file, one entry per worker. The cross section of a
+// selection is sigmaGen * (sum of stored weights passing it) / sumWeights.
+
+#ifndef EVENTWEIGHTS_H
+#define EVENTWEIGHTS_H
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Pythia8/Pythia.h"
+#include "TFile.h"
+#include "TTree.h"
+
+class Unweighter {
+public:
+  explicit Unweighter( double target = 0. ) : target_(target) {}
+
+  bool enabled() const { return target_ > 0.; }
+  double target() const { return target_; }
+
+  // The weight to store for an event of weight w, or 0 if it is rejected.
+  double accept( double w, Pythia8::Rndm & rndm ) {
+    ++nConsidered;
+    sumWeights += w;
+    maxWeight = std::max( maxWeight, std::fabs( w ) );
+    double stored = w;
+    if ( enabled() ) {
+      if ( std::fabs( w ) >= target_ ) {
+	if ( std::fabs( w ) > target_ ) ++nOverweight;
+      } else if ( rndm.flat() * target_ < std::fabs( w ) ) {
+	stored = std::copysign( target_, w );
+      } else {
+	stored = 0.;
+      }
+    }
+    if ( stored != 0. ) {
+      ++nKept;
+      sumStored += stored;
+    }
+    return stored;
+  }
+
+  void print( std::ostream & out ) const {
+    if ( !enabled() ) return;
+    out << " Unweighting to " << target_ << ": kept " << nKept << " of " << nConsidered
+	<< ", " << nOverweight << " overweight (largest weight " << maxWeight << ")" << std::endl;
+  }
+
+  unsigned long nConsidered = 0, nKept = 0, nOverweight = 0;
+  double sumWeights = 0., sumStored = 0., maxWeight = 0.;
+
+protected :
+  double target_;
+};
+
+// One worker's entry of the Runs tree.
+struct WeightSummary {
+  double sigmaGen = 0., sigmaErr = 0.;            // mb, from Pythia
+  Long64_t nTried = 0, nSelected = 0, nAccepted = 0;
+  double weightSum = 0.;                          // Pythia's sum of weights
+  double unweightTarget = 0.;                     // 0 : not unweighted
+  Long64_t nConsidered = 0, nKept = 0, nOverweight = 0;
+  double sumWeights = 0., sumStored = 0., maxWeight = 0.;
+
+  // info is null in recluster-only mode, where Pythia does not run.
+  static WeightSummary from( Pythia8::Info const * info, Unweighter const & unweighter ) {
+    WeightSummary s;
+    if ( info ) {
+      s.sigmaGen = info->sigmaGen();
+      s.sigmaErr = info->sigmaErr();
+      s.nTried = info->nTried();
+      s.nSelected = info->nSelected();
+      s.nAccepted = info->nAccepted();
+      s.weightSum = info->weightSum();
+    }
+    s.unweightTarget = unweighter.target();
+    s.nConsidered = unweighter.nConsidered;
+    s.nKept = unweighter.nKept;
+    s.nOverweight = unweighter.nOverweight;
+    s.sumWeights = unweighter.sumWeights;
+    s.sumStored = unweighter.sumStored;
+    s.maxWeight = unweighter.maxWeight;
+    return s;
+  }
+
+  // Add the tree "Runs" to an existing file, one entry per summary.
+  static bool write( std::string const & filename, std::vector<WeightSummary> const & summaries ) {
+    TFile * file = TFile::Open( filename.c_str(), "update" );
+    if ( !file || file->IsZombie() ) {
+      std::cout << "WeightSummary: cannot update " << filename << std::endl;
+      return false;
+    }
+    WeightSummary s;
+    TTree * runs = new TTree( "Runs", "Cross section and weights per worker" );
+    runs->Branch( "sigmaGen",       &s.sigmaGen,       "sigmaGen/D" );
+    runs->Branch( "sigmaErr",       &s.sigmaErr,       "sigmaErr/D" );
+    runs->Branch( "nTried",         &s.nTried,         "nTried/L" );
+    runs->Branch( "nSelected",      &s.nSelected,      "nSelected/L" );
+    runs->Branch( "nAccepted",      &s.nAccepted,      "nAccepted/L" );
+    runs->Branch( "weightSum",      &s.weightSum,      "weightSum/D" );
+    runs->Branch( "unweightTarget", &s.unweightTarget, "unweightTarget/D" );
+    runs->Branch( "nConsidered",    &s.nConsidered,    "nConsidered/L" );
+    runs->Branch( "nKept",          &s.nKept,          "nKept/L" );
+    runs->Branch( "nOverweight",    &s.nOverweight,    "nOverweight/L" );
+    runs->Branch( "sumWeights",     &s.sumWeights,     "sumWeights/D" );
+    runs->Branch( "sumStored",      &s.sumStored,      "sumStored/D" );
+    runs->Branch( "maxWeight",      &s.maxWeight,      "maxWeight/D" );
+    for ( auto const & summary : summaries ) {
+      s = summary;
+      runs->Fill();
+    }
+    runs->Write();
+    file->Close();
+    delete file;
+    return true;
+  }
+
+  // Cross section of all workers together: each worker's estimate weighted by its number of tries.
+  static void print( std::ostream & out, std::vector<WeightSummary> const & summaries ) {
+    double tried = 0., sigma = 0., err2 = 0.;
+    for ( auto const & s : summaries ) {
+      tried += s.nTried;
+      sigma += s.nTried * s.sigmaGen;
+      err2 += std::pow( s.nTried * s.sigmaErr, 2 );
+    }
+    if ( tried == 0. ) return;
+    out << " Cross section: " << sigma / tried << " +- " << std::sqrt( err2 ) / tried << " mb" << std::endl;
+  }
+};
+
+#endif
@@ -0,0 +1,86 @@
+// Generator.h
+// The Pythia instance behind an event loop.
+//
+// configure() sets the seed and reads the config file the way both
+// executables always have: every line that is not empty and does not
+// start with '!' goes to readString(). Settings that the config file may
+// use beyond Pythia's own (the GenJets:write* flags) have to be added to
+// pythia.settings before. useEventSeeds() and an init-cache directory for
+// init() give the per-event random streams of EventSeeds.h and the reused
+// MPI initialization of InitCache.h. next(eventNum) then generates one
+// event.
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Pythia8/Pythia.h"
+#include "EventSeeds.h"
+#include "InitCache.h"
+
+class Generator {
+public:
+  Pythia8::Pythia pythia;
+
+  // The seed, then the config file, then commands that override it (e.g. from --drop).
+  void configure( std::string const & configfile, long seed, std::vector<std::string> const & commands = {} ) {
+    pythia.readString( "Random:setSeed = on" );
+    pythia.readString( "Random:seed = " + std::to_string( seed ) );
+    std::ifstream config( configfile );
+    while ( !config.eof() ) {
+      std::string line;
+      std::getline( config, line );
+      if ( line[0] != '!' && line != "" && line != "\n" ) {
+	pythia.readString( line );
+      }
+    }
+    for ( auto const & command : commands ) pythia.readString( command );
+  }
+
+  // Random numbers of each event from base and eventNum only. Call before init().
+  void useEventSeeds( uint64_t base ) {
+    eventRandom_ = std::make_shared<EventRandom>( base );
+    pythia.setRndmEnginePtr( eventRandom_ );
+  }
+
+  // pythia.init(), reusing the MPI initialization from initCacheDir unless it is empty.
+  // tag makes the cache's temporary file name unique among concurrent inits.
+  bool init( std::string const & initCacheDir = "", std::string const & tag = "" ) {
+    if ( initCacheDir != "" ) {
+      initCache_.reset( new InitCache( initCacheDir, tag ) );
+      initCache_->configure( pythia );
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool initialized = pythia.init();
+    initSeconds_ = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    if ( initCache_ ) initCache_->finish( initSeconds_, initialized );
+    return initialized;
+  }
+
+  // Generate the event eventNum; false if Pythia failed.
+  bool next( uint64_t eventNum ) {
+    if ( eventRandom_ ) eventRandom_->setEvent( eventNum );
+    return pythia.next();
+  }
+
+  double initSeconds() const { return initSeconds_; }
+  double initSavedSeconds() const { return initCache_ ? initCache_->savedSeconds() : 0.; }
+
+  void print( std::ostream & out ) const {
+    if ( initCache_ ) initCache_->print( out );
+  }
+
+protected :
+  std::shared_ptr<EventRandom> eventRandom_;
+  std::unique_ptr<InitCache> initCache_;
+  double initSeconds_ = 0.;
+};
+
+#endif
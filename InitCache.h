@@ -0,0 +1,99 @@
+// InitCache.h
+// Reuse the multiparton-interaction initialization of earlier runs.
+//
+// Most of pythia.init() for LHC configs is the MPI initialization, which
+// integrates the parton-parton cross sections to set up the impact-parameter
+// machinery. Pythia can save it and read it back
+// (MultipartonInteractions:reuseInit and :initFile). InitCache keys those
+// files on a hash of the changed settings, except Random:* and GenJets:*,
+// so all shards of a config share one file whatever their seeds are:
+//     <dir>/<hash>.mpi     Pythia's MPI initialization
+//     <dir>/<hash>.cmnd    the settings that were hashed, for reference
+//     <dir>/<hash>.time    seconds pythia.init() took when the file was made
+// The first run of a config writes the .mpi file under a temporary name
+// and renames it when init() is done, so shards that start together never
+// read a half-written file. The hard-process phase-space maxima are not
+// covered: Pythia has no way to save them.
+
+#ifndef INITCACHE_H
+#define INITCACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "Pythia8/Pythia.h"
+
+class InitCache {
+public:
+  // tag makes the temporary file name unique, e.g. process id and worker index.
+  InitCache( std::string const & dir, std::string const & tag ) : dir_(dir), tag_(tag) {}
+
+  // Call after all settings are read and before pythia.init().
+  void configure( Pythia8::Pythia & pythia ) {
+    std::stringstream all, hashed;
+    pythia.settings.writeFile( all, false );
+    std::string line;
+    while ( std::getline( all, line ) ) {
+      if ( line.compare( 0, 7, "Random:" ) == 0 || line.compare( 0, 8, "GenJets:" ) == 0 ) continue;
+      hashed << line << "\n";
+    }
+    settings_ = hashed.str();
+    char key[17];
+    std::snprintf( key, sizeof(key), "%016llx", (unsigned long long)( fnv1a( settings_ ) ) );
+    stem_ = dir_ + "/" + key;
+    hit_ = std::ifstream( stem_ + ".mpi" ).good();
+    if ( hit_ ) {
+      pythia.readString( "MultipartonInteractions:reuseInit = 2" );
+      pythia.readString( "MultipartonInteractions:initFile = " + stem_ + ".mpi" );
+      std::ifstream( stem_ + ".time" ) >> cachedSeconds_;
+    } else {
+      pythia.readString( "MultipartonInteractions:reuseInit = 1" );
+      pythia.readString( "MultipartonInteractions:initFile = " + tmpName() );
+    }
+  }
+
+  // Call after pythia.init() with the time it took; stores a new cache entry.
+  void finish( double seconds, bool ok ) {
+    seconds_ = seconds;
+    if ( hit_ ) return;
+    if ( !ok || std::rename( tmpName().c_str(), ( stem_ + ".mpi" ).c_str() ) != 0 ) {
+      std::remove( tmpName().c_str() );
+      return;
+    }
+    std::ofstream( stem_ + ".cmnd" ) << settings_;
+    std::ofstream( stem_ + ".time" ) << seconds << "\n";
+  }
+
+  bool hit() const { return hit_; }
+  double seconds() const { return seconds_; }
+  // Estimated init time saved by the cache: the time of the run that made it minus this one.
+  double savedSeconds() const { return hit_ && cachedSeconds_ > seconds_ ? cachedSeconds_ - seconds_ : 0.; }
+
+  void print( std::ostream & out ) const {
+    out << " InitCache: " << ( hit_ ? "read " : "wrote " ) << stem_ << ".mpi, init took " << seconds_ << " s";
+    if ( hit_ && cachedSeconds_ > 0. ) out << " instead of " << cachedSeconds_ << " s";
+    out << std::endl;
+  }
+
+protected :
+  std::string tmpName() const { return stem_ + ".mpi." + tag_ + ".tmp"; }
+
+  static uint64_t fnv1a( std::string const & s ) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for ( unsigned char c : s ) {
+      h ^= c;
+      h *= 0x100000001b3ULL;
+    }
+    return h;
+  }
+
+  std::string dir_, tag_, stem_, settings_;
+  bool hit_ = false;
+  double seconds_ = 0., cachedSeconds_ = 0.;
+};
+
+#endif
@@ -0,0 +1,142 @@
+// JetCollections.h
+// Several jet collections clustered from the same particles.
+//
+// A collection is given as prefix:algorithm:R:ptmin, e.g.
+//     jet:antikt:0.8:170,ak4:antikt:0.4:20,ak15:antikt:1.5:200,kt10:kt:1.0:30
+// with algorithm antikt, kt or ca (Cambridge/Aachen). Its branches get the
+// prefix (ak4_pt, ...) and the counter n<Prefix> (nAk4, ...).
+//
+// Collections with the same algorithm and R share one ClusterSequence; each
+// takes the inclusive jets above its own ptmin from it.
+
+#ifndef JETCOLLECTIONS_H
+#define JETCOLLECTIONS_H
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "fastjet/ClusterSequence.hh"
+
+struct JetSpec {
+  std::string prefix;
+  fastjet::JetAlgorithm algorithm;
+  double R;
+  double ptmin;
+
+  fastjet::JetDefinition definition() const { return fastjet::JetDefinition( algorithm, R ); }
+
+  // "jet" -> "nJet"
+  std::string counter() const {
+    std::string c = prefix;
+    c[0] = std::toupper( c[0] );
+    return "n" + c;
+  }
+
+  // Parse a comma-separated list; returns an empty list if any entry is malformed,
+  // has R <= 0 or ptmin < 0, or repeats a prefix. The prefixes gen and constituent
+  // are taken by the particle branches.
+  static std::vector<JetSpec> parse( std::string const & list ) {
+    std::vector<JetSpec> specs;
+    std::stringstream ss( list );
+    std::string entry;
+    while ( std::getline( ss, entry, ',' ) ) {
+      if ( entry == "" ) continue;
+      std::vector<std::string> fields;
+      std::stringstream es( entry );
+      std::string field;
+      while ( std::getline( es, field, ':' ) ) fields.push_back( field );
+      JetSpec spec;
+      if ( fields.size() != 4 || fields[0] == "" || !parseAlgorithm( fields[1], spec.algorithm ) ) {
+	std::cout << "JetSpec: cannot parse " << entry << ", expected prefix:antikt|kt|ca:R:ptmin" << std::endl;
+	return {};
+      }
+      spec.prefix = fields[0];
+      if ( !parseNumber( fields[2], spec.R ) || !( spec.R > 0. ) || !parseNumber( fields[3], spec.ptmin ) || !( spec.ptmin >= 0. ) ) {
+	std::cout << "JetSpec: bad R or ptmin in " << entry << ", need R > 0 and ptmin >= 0" << std::endl;
+	return {};
+      }
+      if ( spec.counter() == "nGen" || spec.counter() == "nConstituent" ) {
+	std::cout << "JetSpec: the prefix " << spec.prefix << " clashes with the gen_* or constituent_* branches" << std::endl;
+	return {};
+      }
+      for ( auto const & other : specs ) {
+	if ( other.prefix == spec.prefix || other.counter() == spec.counter() ) {
+	  if ( other.prefix == spec.prefix ) std::cout << "JetSpec: the prefix " << spec.prefix << " is used twice" << std::endl;
+	  else std::cout << "JetSpec: the prefixes " << other.prefix << " and " << spec.prefix << " both have the counter " << spec.counter() << std::endl;
+	  return {};
+	}
+      }
+      specs.push_back( spec );
+    }
+    return specs;
+  }
+
+  static bool parseNumber( std::string const & text, double & value ) {
+    char * end = nullptr;
+    value = std::strtod( text.c_str(), &end );
+    return text != "" && *end == '\0' && std::isfinite( value );
+  }
+
+  static bool parseAlgorithm( std::string const & name, fastjet::JetAlgorithm & algorithm ) {
+    if ( name == "antikt" ) algorithm = fastjet::antikt_algorithm;
+    else if ( name == "kt" ) algorithm = fastjet::kt_algorithm;
+    else if ( name == "ca" ) algorithm = fastjet::cambridge_algorithm;
+    else return false;
+    return true;
+  }
+};
+
+class JetClusterer {
+public:
+  explicit JetClusterer( std::vector<JetSpec> const & specs ) : specs_(specs), jets_(specs.size()) {
+    for ( auto const & spec : specs_ ) {
+      size_t igroup = 0;
+      while ( igroup < groups_.size() && !( groups_[igroup].algorithm == spec.algorithm && groups_[igroup].R == spec.R ) ) ++igroup;
+      if ( igroup == groups_.size() ) groups_.push_back( Group{ spec.algorithm, spec.R, spec.ptmin, nullptr } );
+      groups_[igroup].ptmin = std::min( groups_[igroup].ptmin, spec.ptmin );
+      groupOf_.push_back( igroup );
+    }
+  }
+
+  // Cluster particles once per distinct definition and fill every collection.
+  void cluster( std::vector<fastjet::PseudoJet> const & particles ) {
+    for ( auto & group : groups_ ) {
+      group.cs.reset( new fastjet::ClusterSequence( particles, fastjet::JetDefinition( group.algorithm, group.R ) ) );
+      group.jets = fastjet::sorted_by_pt( group.cs->inclusive_jets( group.ptmin ) );
+    }
+    for ( size_t i = 0; i < specs_.size(); ++i ) {
+      jets_[i].clear();
+      for ( auto const & jet : groups_[groupOf_[i]].jets ) {
+	if ( jet.perp() >= specs_[i].ptmin ) jets_[i].push_back( jet );
+      }
+    }
+  }
+
+  size_t size() const { return specs_.size(); }
+  size_t nClusterings() const { return groups_.size(); }
+  JetSpec const & spec( size_t i ) const { return specs_[i]; }
+  // Jets of collection i from the last cluster(), sorted by pt.
+  std::vector<fastjet::PseudoJet> const & jets( size_t i ) const { return jets_[i]; }
+
+protected :
+  struct Group {
+    fastjet::JetAlgorithm algorithm;
+    double R;
+    double ptmin;                       // lowest ptmin of its collections
+    std::unique_ptr<fastjet::ClusterSequence> cs;
+    std::vector<fastjet::PseudoJet> jets;
+  };
+
+  std::vector<JetSpec> specs_;
+  std::vector<Group> groups_;
+  std::vector<size_t> groupOf_;
+  std::vector<std::vector<fastjet::PseudoJet> > jets_;
+};
+
+#endif
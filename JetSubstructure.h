@@ -0,0 +1,72 @@
+// JetSubstructure.h
+// The per-jet part of the jets stage, shared by pythia2root, mpt2root and
+// genjets_cpp.
+//
+// accept() applies the lepton-fraction cut: jets with more than lepfrac of
+// their energy from leptons (|id| 11 ... 16), such as the isolated leptons
+// of Z->ll, are not stored. groom() runs the SoftDrop grooming at the main
+// and the scan points (SoftDropScan.h), and taus() the N-subjettiness of a
+// jet or of one of its groomed versions (NsubjettinessEngine.h), handing
+// each tau to the driver's own columns.
+
+#ifndef JETSUBSTRUCTURE_H
+#define JETSUBSTRUCTURE_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "fastjet/PseudoJet.hh"
+#include "SoftDropScan.h"
+#include "NsubjettinessEngine.h"
+
+class JetSubstructure {
+public:
+  // maxN = 0: no N-subjettiness.
+  JetSubstructure( GroomingPoint const & main, std::vector<GroomingPoint> const & scan,
+		   unsigned int maxN, std::vector<double> const & betas, double lepfrac ) :
+    groomer_(main, scan), nsj_(maxN, betas), lepfrac_(lepfrac)
+  {}
+
+  // Whether jet passes the lepton-fraction cut. ids[i] is the PDG id of the
+  // constituent with user_index i; verbose prints the leptons found.
+  bool accept( fastjet::PseudoJet const & jet, std::vector<fastjet::PseudoJet> const & constituents,
+	       std::vector<int> const & ids, bool verbose = false ) const {
+    fastjet::PseudoJet lepp4;
+    for ( auto const & con : constituents ) {
+      int id = ids[con.user_index()];
+      if ( std::abs( id ) > 10 && std::abs( id ) < 16 ) {
+	if ( verbose ) {
+	  char buff[1000];
+	  sprintf( buff, "  lepton  :  id=%6d  p4=(%6.4f,%6.2f,%6.2f,%6.4f)", id, con.pt(), con.eta(), con.phi(), con.m() );
+	  std::cout << buff << std::endl;
+	}
+	lepp4 += con;
+      }
+    }
+    return !( lepp4.e() / jet.e() > lepfrac_ );
+  }
+
+  // Groom jet at every grooming point; read back with groomer().main() and scanned().
+  void groom( fastjet::PseudoJet const & jet ) { groomer_.groom( jet ); }
+  SoftDropScan const & groomer() const { return groomer_; }
+
+  // Compute tau_1 ... tau_maxN of jet at every beta and call out( N, ibeta, tau ) for each.
+  template <class Out>
+  void taus( fastjet::PseudoJet const & jet, Out && out ) {
+    nsj_.compute( jet );
+    for ( unsigned int N = 1; N <= nsj_.maxN(); ++N )
+      for ( unsigned int ibeta = 0; ibeta < nsj_.betas().size(); ++ibeta ) out( N, ibeta, nsj_.tau( N, ibeta ) );
+  }
+
+  unsigned int maxN() const { return nsj_.maxN(); }
+  std::vector<double> const & betas() const { return nsj_.betas(); }
+
+protected :
+  SoftDropScan groomer_;
+  NsubjettinessEngine nsj_;
+  double lepfrac_;
+};
+
+#endif
@@ -0,0 +1,173 @@
+// JetTensors.h
+// Jet images and particle clouds for the ML taggers, made once at generation
+// time instead of in every training epoch.
+//
+// Both are in a frame centred on the jet axis, or on the leading SoftDrop
+// subjet (the harder of sd_jet.pieces()), with deta = eta - eta_centre and
+// dphi = phi - phi_centre wrapped to [-pi, pi). With rotation the frame is
+// then turned so that the pt-weighted principal axis of the constituents
+// lies along deta, and flipped so that most of the pt is at deta >= 0 and
+// dphi >= 0.
+//
+// The image has npix x npix pixels covering [-R, R] in deta and dphi, stored
+// row by row (ieta * npix + iphi). Each pixel is the pt of its constituents,
+// or their fraction of the jet pt when normalized.
+// The particle cloud has the ncloud highest-pt constituents, each as
+// (deta, dphi, pt, e), or (deta, dphi, pt / jet pt, e / jet e) when
+// normalized, padded with zeros.
+//
+// The frame, the rotation and the pixel indices are computed in plain loops
+// over contiguous arrays, which vectorize with the CXX_SIMD flags of the
+// Makefile; only the pixel sums are a scalar scatter.
+
+#ifndef JETTENSORS_H
+#define JETTENSORS_H
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "fastjet/PseudoJet.hh"
+
+#include "EventRecord.h"
+
+struct JetTensorOptions {
+  TensorShape shape;
+  bool subjetCentre = false;          // centre on the leading SoftDrop subjet instead of the jet axis
+  bool rotate = true;
+  bool normalize = true;
+
+  bool enabled() const { return shape.npix > 0 || shape.ncloud > 0; }
+
+  bool parseCentre( std::string const & name ) {
+    if ( name == "axis" ) subjetCentre = false;
+    else if ( name == "subjet" ) subjetCentre = true;
+    else {
+      std::cout << "JetTensors: unknown centre " << name << ", use axis or subjet" << std::endl;
+      return false;
+    }
+    return true;
+  }
+};
+
+class JetRasterizer {
+public:
+  explicit JetRasterizer( JetTensorOptions const & options ) : options_(options) {}
+
+  // Fill the image (npix * npix floats) and the cloud (ncloud rows) of jet, whose
+  // constituents are given; groomed is its SoftDrop jet and R the jet radius.
+  // Either output may be null.
+  void fill( fastjet::PseudoJet const & jet, std::vector<fastjet::PseudoJet> const & constituents,
+	     fastjet::PseudoJet const & groomed, double R, Float_t * image, JetColumns::CloudRow * cloud ) {
+    size_t n = constituents.size();
+    deta_.resize( n );
+    dphi_.resize( n );
+    pt_.resize( n );
+    e_.resize( n );
+    for ( size_t i = 0; i < n; ++i ) {
+      deta_[i] = constituents[i].eta();
+      dphi_[i] = constituents[i].phi();
+      pt_[i] = constituents[i].perp();
+      e_[i] = constituents[i].e();
+    }
+    float eta0 = jet.eta(), phi0 = jet.phi();
+    if ( options_.subjetCentre ) {
+      auto pieces = groomed.pieces();
+      if ( pieces.size() > 0 ) {
+	auto const & lead = pieces.size() > 1 && pieces[1].perp2() > pieces[0].perp2() ? pieces[1] : pieces[0];
+	eta0 = lead.eta();
+	phi0 = lead.phi();
+      }
+    }
+    centre( eta0, phi0 );
+    if ( options_.rotate ) rotate();
+    float ptScale = options_.normalize && jet.perp() > 0 ? 1. / jet.perp() : 1.;
+    float eScale = options_.normalize && jet.e() > 0 ? 1. / jet.e() : 1.;
+    if ( image && options_.shape.npix > 0 ) rasterize( R, ptScale, image );
+    if ( cloud && options_.shape.ncloud > 0 ) leading( ptScale, eScale, cloud );
+  }
+
+protected :
+  // deta, dphi relative to (eta0, phi0), dphi in [-pi, pi).
+  void centre( float eta0, float phi0 ) {
+    const float pi = M_PI, twopi = 2 * M_PI;
+    size_t n = deta_.size();
+    float * deta = deta_.data();
+    float * dphi = dphi_.data();
+    for ( size_t i = 0; i < n; ++i ) {
+      float dp = dphi[i] - phi0;
+      deta[i] -= eta0;
+      dphi[i] = dp - twopi * std::floor( ( dp + pi ) / twopi );
+    }
+  }
+
+  // Turn the pt-weighted principal axis onto deta, then flip the larger pt to positive deta and dphi.
+  void rotate() {
+    size_t n = deta_.size();
+    float * deta = deta_.data();
+    float * dphi = dphi_.data();
+    float const * pt = pt_.data();
+    float sxx = 0, syy = 0, sxy = 0;
+    for ( size_t i = 0; i < n; ++i ) {
+      sxx += pt[i] * deta[i] * deta[i];
+      syy += pt[i] * dphi[i] * dphi[i];
+      sxy += pt[i] * deta[i] * dphi[i];
+    }
+    float theta = 0.5 * std::atan2( 2 * sxy, sxx - syy );
+    float c = std::cos( theta ), s = std::sin( theta );
+    float sx = 0, sy = 0;
+    for ( size_t i = 0; i < n; ++i ) {
+      float x = c * deta[i] + s * dphi[i];
+      float y = -s * deta[i] + c * dphi[i];
+      deta[i] = x;
+      dphi[i] = y;
+      sx += pt[i] * x;
+      sy += pt[i] * y;
+    }
+    float fx = sx < 0 ? -1 : 1, fy = sy < 0 ? -1 : 1;
+    for ( size_t i = 0; i < n; ++i ) {
+      deta[i] *= fx;
+      dphi[i] *= fy;
+    }
+  }
+
+  void rasterize( double R, float ptScale, Float_t * image ) {
+    size_t n = deta_.size();
+    int npix = options_.shape.npix;
+    float inv = npix / ( 2 * R ), r = R;
+    pixel_.resize( n );
+    int * pixel = pixel_.data();
+    float const * deta = deta_.data();
+    float const * dphi = dphi_.data();
+    for ( size_t i = 0; i < n; ++i ) {
+      int ix = std::floor( ( deta[i] + r ) * inv );
+      int iy = std::floor( ( dphi[i] + r ) * inv );
+      bool inside = ix >= 0 && ix < npix && iy >= 0 && iy < npix;
+      pixel[i] = inside ? ix * npix + iy : -1;
+    }
+    std::fill( image, image + npix * npix, 0.f );
+    for ( size_t i = 0; i < n; ++i ) if ( pixel[i] >= 0 ) image[pixel[i]] += pt_[i] * ptScale;
+  }
+
+  void leading( float ptScale, float eScale, JetColumns::CloudRow * cloud ) {
+    size_t n = deta_.size(), ncloud = options_.shape.ncloud;
+    size_t m = std::min( n, ncloud );
+    order_.resize( n );
+    std::iota( order_.begin(), order_.end(), 0 );
+    std::partial_sort( order_.begin(), order_.begin() + m, order_.end(), [this]( int a, int b ) { return pt_[a] > pt_[b]; } );
+    for ( size_t k = 0; k < m; ++k ) {
+      int i = order_[k];
+      cloud[k] = JetColumns::CloudRow{ { deta_[i], dphi_[i], pt_[i] * ptScale, e_[i] * eScale } };
+    }
+    for ( size_t k = m; k < ncloud; ++k ) cloud[k].fill( 0.f );
+  }
+
+  JetTensorOptions options_;
+  std::vector<float> deta_, dphi_, pt_, e_;
+  std::vector<int> pixel_, order_;
+};
+
+#endif
@@ -0,0 +1,71 @@
+// NsubjettinessEngine.h
+// Computes the tau_1 ... tau_maxN table for several angular exponents beta
+// in one go.
+//
+// OnePass_WTA_KT_Axes seeds tau_N with the N exclusive jets of a WTA kT
+// clustering of the jet constituents, then refines them with one
+// minimisation pass that depends on beta. All the seeds for N = 1 ... maxN
+// come from the same clustering history, so here that clustering is done
+// once per jet and the seeds are handed to OnePass_Manual_Axes, which runs
+// the same refinement. The taus are identical to the ones from
+// OnePass_WTA_KT_Axes, but a jet costs one clustering instead of
+// maxN x nBeta of them.
+
+#ifndef NSUBJETTINESSENGINE_H
+#define NSUBJETTINESSENGINE_H
+
+#include <memory>
+#include <vector>
+
+#include "fastjet/ClusterSequence.hh"
+#include "fastjet/contrib/Nsubjettiness.hh"
+
+class NsubjettinessEngine {
+public:
+  NsubjettinessEngine( unsigned int maxN, std::vector<double> const & betas ) :
+    maxN_(maxN), betas_(betas),
+    wta_def_(fastjet::kt_algorithm, fastjet::JetDefinition::max_allowable_R, fastjet::WTA_pt_scheme, fastjet::Best),
+    taus_(maxN * betas.size(), 0.0)
+  {
+    // Unnormalized measure, ordered as [N-1][ibeta].
+    for ( unsigned int N = 1; N <= maxN_; ++N ) {
+      for ( auto beta : betas_ ) {
+	nsub_.emplace_back( new fastjet::contrib::Nsubjettiness(N, fastjet::contrib::OnePass_Manual_Axes(), fastjet::contrib::UnnormalizedMeasure(beta)) );
+      }
+    }
+  }
+
+  // Evaluate every (N, beta) combination on jet. Read back with tau().
+  void compute( fastjet::PseudoJet const & jet ) {
+    auto particles = jet.constituents();
+    unsigned int nbeta = betas_.size();
+    // Nsubjettiness gives zero when there are no more particles than axes.
+    for ( auto & tau : taus_ ) tau = 0.0;
+    fastjet::ClusterSequence wta_cs(particles, wta_def_);
+    for ( unsigned int N = 1; N <= maxN_; ++N ) {
+      if ( particles.size() <= N ) break;
+      auto seeds = wta_cs.exclusive_jets_up_to(N);
+      seeds.resize( N );
+      for ( unsigned int ibeta = 0; ibeta < nbeta; ++ibeta ) {
+	auto & nsub = *nsub_[(N-1)*nbeta + ibeta];
+	nsub.setAxes( seeds );       // the refined axes overwrite the seeds, so set them every time
+	taus_[(N-1)*nbeta + ibeta] = nsub(jet);
+      }
+    }
+  }
+
+  // tau_N at betas[ibeta] from the last compute().
+  double tau( unsigned int N, unsigned int ibeta ) const { return taus_[(N-1)*betas_.size() + ibeta]; }
+
+  unsigned int maxN() const { return maxN_; }
+  std::vector<double> const & betas() const { return betas_; }
+
+protected :
+  unsigned int maxN_;
+  std::vector<double> betas_;
+  fastjet::JetDefinition wta_def_;
+  std::vector<std::unique_ptr<fastjet::contrib::Nsubjettiness> > nsub_;
+  std::vector<double> taus_;
+};
+
+#endif
@@ -0,0 +1,80 @@
+// OutputSchema.h
+// Which branch groups pythia2root writes.
+//
+// The groups are Pythia settings, so they can be switched in the config
+// file, e.g.
+//     GenJets:writeVertices = off
+// or from the command line with --drop vertices,history. Quantities of a
+// disabled group are not computed at all.
+//
+//   history        : *_mother1/2, *_daughter1/2, *_col
+//   vertices       : *_vxx, *_vyy, *_vzz, *_tau
+//   constituents   : nConstituent, constituent_*, nJetConstituent, jet_nic, jet_ic
+//   nsubjettiness  : jet_tau1 ... jet_tau8 and their _sd versions
+//   subjets        : jet_nsubjet, jet_subjet0_*, jet_subjet1_*, constituent_subjetndx
+
+#ifndef OUTPUTSCHEMA_H
+#define OUTPUTSCHEMA_H
+
+#include <cctype>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Pythia8/Pythia.h"
+
+struct OutputSchema {
+  bool history = true;
+  bool vertices = true;
+  bool constituents = true;
+  bool nsubjettiness = true;
+  bool subjets = true;
+
+  // Register the GenJets:write* flags; call before reading the config file.
+  static void addSettings( Pythia8::Settings & settings ) {
+    for ( auto const & group : groups() ) settings.addFlag( flagName( group ), true );
+  }
+
+  static OutputSchema fromSettings( Pythia8::Settings & settings ) {
+    OutputSchema schema;
+    schema.history       = settings.flag( flagName("history") );
+    schema.vertices      = settings.flag( flagName("vertices") );
+    schema.constituents  = settings.flag( flagName("constituents") );
+    schema.nsubjettiness = settings.flag( flagName("nsubjettiness") );
+    schema.subjets       = settings.flag( flagName("subjets") );
+    return schema;
+  }
+
+  // Append to commands the readString commands that switch off the groups of
+  // "vertices,history"; returns false if a group is unknown.
+  static bool dropCommands( std::string const & list, std::vector<std::string> & commands ) {
+    std::stringstream ss( list );
+    std::string group;
+    while ( std::getline( ss, group, ',' ) ) {
+      if ( group == "" ) continue;
+      bool known = false;
+      for ( auto const & g : groups() ) known = known || g == group;
+      if ( !known ) {
+	std::cout << "OutputSchema: unknown branch group " << group << ", use";
+	for ( auto const & g : groups() ) std::cout << " " << g;
+	std::cout << std::endl;
+	return false;
+      }
+      commands.push_back( flagName( group ) + " = off" );
+    }
+    return true;
+  }
+
+  static std::vector<std::string> const & groups() {
+    static const std::vector<std::string> names = { "history", "vertices", "constituents", "nsubjettiness", "subjets" };
+    return names;
+  }
+
+  static std::string flagName( std::string group ) {
+    group[0] = std::toupper( group[0] );
+    return "GenJets:write" + group;
+  }
+};
+
+#endif
@@ -0,0 +1,181 @@
+// ParticleCache.h
+// Binary cache of the final-state particles that pythia2root clusters, so
+// that jets can be rebuilt with other settings without running Pythia.
+//
+// Layout (native byte order, all offsets in bytes):
+//   ParticleCacheHeader
+//   CachedParticle[nParticles]        events one after the other
+//   CachedEvent[nEvents]              at header.indexOffset
+// The writer appends events as they come and writes the index and the
+// final header on close(). The reader maps the file into memory, so an
+// event is just a pointer into the particle block.
+
+#ifndef PARTICLECACHE_H
+#define PARTICLECACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Pythia8/Pythia.h"
+
+// Bits of the *_flags branches.
+inline int32_t particleFlags( Pythia8::Particle const & p ) {
+  return p.isHadron() << 3 | p.isFinal() << 2 | p.isFinalPartonLevel() << 1 | p.isVisible() << 0;
+}
+
+struct CachedParticle {
+  float px, py, pz, e, m;
+  int32_t id;
+  int32_t status;
+  int32_t flags;
+  int32_t index;                        // position in the Pythia event record
+
+  static CachedParticle from( Pythia8::Particle const & p, int i ) {
+    return CachedParticle{ float(p.px()), float(p.py()), float(p.pz()), float(p.e()), float(p.m()),
+	p.id(), p.status(), particleFlags( p ), i };
+  }
+};
+
+struct CachedEvent {
+  uint64_t eventNum;
+  uint64_t first;                       // index of the first particle
+  uint32_t n;
+  uint32_t eventSize;                   // size of the Pythia event record, bounds CachedParticle::index
+  double weight;                        // event weight as written to the weight branch
+};
+
+struct ParticleCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t particleSize;
+  uint64_t nEvents;
+  uint64_t indexOffset;
+};
+
+static const char kParticleCacheMagic[8] = { 'G', 'J', 'P', 'C', 'A', 'C', 'H', 'E' };
+static const uint32_t kParticleCacheVersion = 2;
+
+// Thread safe: each write() appends one whole event.
+class ParticleCacheWriter {
+public:
+  explicit ParticleCacheWriter( std::string const & filename ) : file_( std::fopen( filename.c_str(), "wb" ) ) {
+    if ( !file_ ) {
+      std::cout << "ParticleCacheWriter: cannot open " << filename << std::endl;
+      return;
+    }
+    ParticleCacheHeader header = makeHeader();
+    std::fwrite( &header, sizeof(header), 1, file_ );
+  }
+  ParticleCacheWriter( ParticleCacheWriter const & ) = delete;
+  ParticleCacheWriter & operator=( ParticleCacheWriter const & ) = delete;
+  ~ParticleCacheWriter() { close(); }
+
+  bool good() const { return file_ != nullptr; }
+
+  void write( uint64_t eventNum, uint32_t eventSize, double weight, std::vector<CachedParticle> const & particles ) {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    if ( !file_ ) return;
+    index_.push_back( CachedEvent{ eventNum, nParticles_, uint32_t(particles.size()), eventSize, weight } );
+    std::fwrite( particles.data(), sizeof(CachedParticle), particles.size(), file_ );
+    nParticles_ += particles.size();
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    if ( !file_ ) return;
+    // Pad so that the index is 8-byte aligned in the mapped file.
+    uint64_t offset = sizeof(ParticleCacheHeader) + nParticles_ * sizeof(CachedParticle);
+    static const char pad[8] = {};
+    std::fwrite( pad, 1, ( 8 - offset % 8 ) % 8, file_ );
+    offset += ( 8 - offset % 8 ) % 8;
+    std::fwrite( index_.data(), sizeof(CachedEvent), index_.size(), file_ );
+    ParticleCacheHeader header = makeHeader();
+    header.nEvents = index_.size();
+    header.indexOffset = offset;
+    std::fseek( file_, 0, SEEK_SET );
+    std::fwrite( &header, sizeof(header), 1, file_ );
+    std::fclose( file_ );
+    file_ = nullptr;
+  }
+
+protected :
+  static ParticleCacheHeader makeHeader() {
+    ParticleCacheHeader header;
+    std::memcpy( header.magic, kParticleCacheMagic, sizeof(header.magic) );
+    header.version = kParticleCacheVersion;
+    header.particleSize = sizeof(CachedParticle);
+    header.nEvents = 0;
+    header.indexOffset = 0;
+    return header;
+  }
+
+  std::FILE * file_;
+  std::vector<CachedEvent> index_;
+  uint64_t nParticles_ = 0;
+  std::mutex mutex_;
+};
+
+// Read-only view of a cache file. Several threads can read it at once.
+class ParticleCacheReader {
+public:
+  explicit ParticleCacheReader( std::string const & filename ) {
+    int fd = ::open( filename.c_str(), O_RDONLY );
+    struct stat st;
+    if ( fd < 0 || ::fstat( fd, &st ) != 0 || size_t(st.st_size) < sizeof(ParticleCacheHeader) ) {
+      std::cout << "ParticleCacheReader: cannot read " << filename << std::endl;
+      if ( fd >= 0 ) ::close( fd );
+      return;
+    }
+    void * data = ::mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if ( data == MAP_FAILED ) {
+      std::cout << "ParticleCacheReader: cannot map " << filename << std::endl;
+      return;
+    }
+    data_ = static_cast<char const *>( data );
+    size_ = st.st_size;
+    header_ = reinterpret_cast<ParticleCacheHeader const *>( data_ );
+    if ( std::memcmp( header_->magic, kParticleCacheMagic, sizeof(header_->magic) ) != 0
+	 || header_->version != kParticleCacheVersion || header_->particleSize != sizeof(CachedParticle)
+	 || header_->indexOffset + header_->nEvents * sizeof(CachedEvent) > size_ ) {
+      std::cout << "ParticleCacheReader: " << filename << " is not a complete particle cache" << std::endl;
+      unmap();
+      return;
+    }
+    particles_ = reinterpret_cast<CachedParticle const *>( data_ + sizeof(ParticleCacheHeader) );
+    index_ = reinterpret_cast<CachedEvent const *>( data_ + header_->indexOffset );
+  }
+  ParticleCacheReader( ParticleCacheReader const & ) = delete;
+  ParticleCacheReader & operator=( ParticleCacheReader const & ) = delete;
+  ~ParticleCacheReader() { unmap(); }
+
+  bool good() const { return data_ != nullptr; }
+  uint64_t size() const { return good() ? header_->nEvents : 0; }
+
+  CachedEvent const & event( uint64_t i ) const { return index_[i]; }
+  CachedParticle const * particles( CachedEvent const & ev ) const { return particles_ + ev.first; }
+
+protected :
+  void unmap() {
+    if ( data_ ) ::munmap( const_cast<char *>( data_ ), size_ );
+    data_ = nullptr;
+  }
+
+  char const * data_ = nullptr;
+  size_t size_ = 0;
+  ParticleCacheHeader const * header_ = nullptr;
+  CachedParticle const * particles_ = nullptr;
+  CachedEvent const * index_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,71 @@
+// ParticleSelector.h
+// The particles an event's jets are clustered from.
+//
+// The event loop add()s the four-momenta of the candidate particles with
+// their Pythia event index. select() computes pt, eta and phi of all of
+// them in one batch (BatchKinematics.h), applies the |eta| cut and an
+// optional veto, and turns the rest into PseudoJets whose user_index is
+// the Pythia event index. The batch stays available, e.g. to copy pt, eta
+// and phi into the constituent_* columns.
+//
+// addEvent() makes the split of a Pythia event that every driver uses: the
+// final parton-level particles and the resonances are generator-level
+// (the gen_* columns) and are not clustered; the other final-state
+// particles are added.
+
+#ifndef PARTICLESELECTOR_H
+#define PARTICLESELECTOR_H
+
+#include <cmath>
+#include <functional>
+#include <vector>
+
+#include "fastjet/PseudoJet.hh"
+#include "BatchKinematics.h"
+
+class ParticleSelector {
+public:
+  // maxAbsEta <= 0 : no eta cut.
+  explicit ParticleSelector( double maxAbsEta = 0. ) : maxAbsEta_(maxAbsEta) {}
+
+  void clear() { batch_.clear(); }
+  void add( double px, double py, double pz, double e, int index ) { batch_.add( px, py, pz, e, index ); }
+
+  // Add the final-state particles of a Pythia8::Event that are not generator-level,
+  // calling clustered( particle, index ) for each; gen( particle, index ) is
+  // called for the generator-level ones.
+  template <class Event, class GenFn, class ClusteredFn>
+  void addEvent( Event const & event, GenFn && gen, ClusteredFn && clustered ) {
+    for ( int i = 0; i < event.size(); ++i ) {
+      auto const & p = event[i];
+      if ( p.isFinalPartonLevel() || p.isResonance() ) {
+	gen( p, i );
+      } else if ( p.isFinal() ) {
+	add( p.px(), p.py(), p.pz(), p.e(), i );
+	clustered( p, i );
+      }
+    }
+  }
+
+  // Replace particles by the selected ones. veto( index ) can reject more, after the eta cut.
+  void select( std::vector<fastjet::PseudoJet> & particles, std::function<bool( int )> const & veto = nullptr ) {
+    batch_.compute();
+    particles.clear();
+    particles.reserve( batch_.size() );
+    for ( size_t j = 0; j < batch_.size(); ++j ) {
+      if ( maxAbsEta_ > 0. && std::abs( batch_.eta[j] ) >= maxAbsEta_ ) continue;
+      if ( veto && veto( batch_.index[j] ) ) continue;
+      particles.emplace_back( batch_.px[j], batch_.py[j], batch_.pz[j], batch_.e[j] );
+      particles.back().set_user_index( batch_.index[j] );
+    }
+  }
+
+  // Every added particle, with pt, eta and phi after select().
+  KinematicsBatch const & batch() const { return batch_; }
+
+protected :
+  double maxAbsEta_;
+  KinematicsBatch batch_;
+};
+
+#endif
@@ -0,0 +1,97 @@
+// PartonLevelVeto.h
+// UserHooks that vetoes events before hadronization when they cannot pass
+// the leading-jet cut.
+//
+// After the parton shower the final partons (and leptons/photons) are
+// clustered with the analysis jet definition. If the leading proxy jet is
+// below (1 - margin) * ptmin, the event is vetoed and Pythia moves on to a
+// new one inside the same call to next(), so no time is spent on
+// hadronization and decays. Vetoed events are removed from the
+// cross-section bookkeeping by Pythia itself.
+//
+// To check the margin, every auditEvery-th event that would be vetoed is
+// let through instead. takeAudited() right after next() tells whether the
+// event is one of those, and its real outcome is passed back with
+// recordAudit(), possibly after later events were generated. The fraction
+// of those events that pass the cut estimates how many good events the
+// veto loses.
+
+#ifndef PARTONLEVELVETO_H
+#define PARTONLEVELVETO_H
+
+#include <iostream>
+#include <vector>
+
+#include "Pythia8/Pythia.h"
+#include "fastjet/ClusterSequence.hh"
+
+class PartonLevelVeto : public Pythia8::UserHooks {
+public:
+  PartonLevelVeto( fastjet::JetDefinition const & jet_def, double ptmin, double margin, unsigned long auditEvery = 0 ) :
+    jet_def_(jet_def), ptcut_( (1.0 - margin) * ptmin ), margin_(margin), auditEvery_(auditEvery)
+  {}
+
+  bool canVetoPartonLevel() override { return true; }
+
+  bool doVetoPartonLevel( const Pythia8::Event & event ) override {
+    audited_ = false;
+    ++nChecked_;
+
+    partons_.clear();
+    for ( int i = 0; i < event.size(); ++i ) {
+      auto const & p = event[i];
+      if ( p.isFinal() ) partons_.emplace_back( p.px(), p.py(), p.pz(), p.e() );
+    }
+    fastjet::ClusterSequence cs(partons_, jet_def_);
+    double ptlead = 0.;
+    for ( auto const & jet : cs.inclusive_jets(ptcut_) ) ptlead = std::max( ptlead, jet.perp() );
+    if ( ptlead >= ptcut_ ) return false;
+
+    ++nWouldVeto_;
+    if ( auditEvery_ > 0 && nWouldVeto_ % auditEvery_ == 0 ) {
+      audited_ = true;
+      return false;
+    }
+    ++nVetoed_;
+    return true;
+  }
+
+  // Whether the event from the last next() is an audited would-be veto; call once per next().
+  bool takeAudited() {
+    bool audited = audited_;
+    audited_ = false;
+    return audited;
+  }
+
+  // Tell the hook whether an audited event was stored.
+  void recordAudit( bool passed ) {
+    ++nAudited_;
+    if ( passed ) ++nAuditedPassed_;
+  }
+
+  unsigned long nChecked() const { return nChecked_; }
+  unsigned long nVetoed() const { return nVetoed_; }
+  unsigned long nAudited() const { return nAudited_; }
+  unsigned long nAuditedPassed() const { return nAuditedPassed_; }
+
+  void print( std::ostream & out ) const {
+    out << " PartonLevelVeto: proxy jet pt cut = " << ptcut_ << " (margin " << margin_ << ")" << std::endl;
+    out << "   checked " << nChecked_ << ", vetoed " << nVetoed_ << std::endl;
+    if ( nAudited_ > 0 ) {
+      double lost = double(nAuditedPassed_) / nAudited_;
+      out << "   audited " << nAudited_ << " would-be vetoes, " << nAuditedPassed_ << " passed the cut"
+	  << " -> about " << lost * nVetoed_ << " good events lost to the veto" << std::endl;
+    }
+  }
+
+protected :
+  fastjet::JetDefinition jet_def_;
+  double ptcut_;
+  double margin_;
+  unsigned long auditEvery_;
+  std::vector<fastjet::PseudoJet> partons_;
+  bool audited_ = false;
+  unsigned long nChecked_ = 0, nWouldVeto_ = 0, nVetoed_ = 0, nAudited_ = 0, nAuditedPassed_ = 0;
+};
+
+#endif
@@ -0,0 +1,119 @@
+// Pipeline.h
+// Runs the stages of an event loop one after the other on every event,
+// either inline or with one thread per stage.
+//
+// A stage is a function on a slot, the per-event state that is handed from
+// stage to stage (the particles, the output record, ...). The first stage
+// is the source: it fills a free slot with the next event, and returns
+// false when there are no more events (the other stages' return values are
+// ignored). Every slot goes through every stage in the order the source
+// filled them, so a stage can keep running state (counters, the output
+// tree). Events that should go no further are marked in the slot by the
+// stage that rejects them; the later stages skip them.
+//
+// Inline (threaded = false), run() is just the event loop. Threaded, each
+// stage has its own thread and the slots queue between them, so e.g. event
+// n+1 is generated while event n is clustered and event n-1 is written.
+// There are a fixed number of slots; the source waits when all of them are
+// in use. Each stage may only touch its own state and the slot it is given.
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+template<class Slot>
+class Pipeline {
+public:
+  typedef std::function<bool( Slot & )> Stage;
+
+  // slots: the slots to cycle through; inline only the first one is used.
+  Pipeline( std::vector<std::string> const & names, std::vector<Stage> const & stages, std::vector<Slot *> const & slots, bool threaded ) :
+    names_(names), stages_(stages), slots_(slots), threaded_(threaded),
+    queues_(stages.size()), busySeconds_(stages.size(), 0.), waitSeconds_(stages.size(), 0.)
+  {}
+  Pipeline( Pipeline const & ) = delete;
+  Pipeline & operator=( Pipeline const & ) = delete;
+
+  // Run until the source returns false and every event has gone through every stage.
+  void run() {
+    if ( !threaded_ ) {
+      Slot & slot = *slots_[0];
+      while ( stages_[0]( slot ) ) {
+	for ( size_t i = 1; i < stages_.size(); ++i ) stages_[i]( slot );
+      }
+      return;
+    }
+    for ( auto slot : slots_ ) free_.push_back( slot );
+    std::vector<std::thread> threads;
+    for ( size_t i = 0; i < stages_.size(); ++i ) threads.emplace_back( [this, i]() { runStage( i ); } );
+    for ( auto & thread : threads ) thread.join();
+  }
+
+  bool threaded() const { return threaded_; }
+
+  // Where each stage thread spent its time: working, or waiting for a slot.
+  void print( std::ostream & out ) const {
+    if ( !threaded_ ) return;
+    out << " Pipeline: " << stages_.size() << " stages, " << slots_.size() << " slots" << std::endl;
+    char buff[1000];
+    for ( size_t i = 0; i < stages_.size(); ++i ) {
+      sprintf( buff, "   %-16s busy %10.3f s, waiting %10.3f s", names_[i].c_str(), busySeconds_[i], waitSeconds_[i] );
+      out << buff << std::endl;
+    }
+  }
+
+protected :
+  // Slots come from free_ (stage 0) or queues_[i], and go to queues_[i+1] (or back
+  // to free_ after the last stage). A null slot marks the end of the events.
+  void runStage( size_t i ) {
+    for (;;) {
+      Slot * slot = nullptr;
+      {
+	auto start = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> lock( mutex_ );
+	std::deque<Slot *> & in = i == 0 ? free_ : queues_[i];
+	ready_.wait( lock, [&in]() { return !in.empty(); } );
+	slot = in.front();
+	in.pop_front();
+	waitSeconds_[i] += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+      }
+      auto start = std::chrono::steady_clock::now();
+      bool more = slot && stages_[i]( *slot );
+      busySeconds_[i] += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+      {
+	std::lock_guard<std::mutex> lock( mutex_ );
+	if ( i == 0 && !more ) {
+	  // The source is done: the slot goes back unused and the end marker follows the events.
+	  if ( slot ) free_.push_back( slot );
+	  slot = nullptr;
+	}
+	if ( i + 1 < stages_.size() ) queues_[i+1].push_back( slot );
+	else if ( slot ) free_.push_back( slot );
+      }
+      ready_.notify_all();
+      if ( !slot ) return;
+    }
+  }
+
+  std::vector<std::string> names_;
+  std::vector<Stage> stages_;
+  std::vector<Slot *> slots_;
+  bool threaded_;
+  std::deque<Slot *> free_;
+  std::vector<std::deque<Slot *> > queues_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::vector<double> busySeconds_, waitSeconds_;
+};
+
+#endif
@@ -0,0 +1,150 @@
+// RNTupleOutput.h
+// Writes the GenJetsEvent model as an RNTuple named "T" instead of a TTree.
+//
+// Every written column becomes a std::vector field with the branch name
+// (jet_pt, gen_id, jet_tau1 as std::vector<std::array<float,4>>, ...), and
+// the counters nJet, nGen, ... are kept as plain int fields so that code
+// written against the tree keeps working. The SoftDrop scan columns become
+// vectors of vectors (jet_sdscan_msd as std::vector<std::vector<float>>,
+// the inner vector indexed by the grooming point). The vector fields carry their own
+// offsets, so the columnar readers do not need the counters.
+//
+// The model is made from the first event record handed to filler(), after
+// its output schema has been applied. Each worker thread gets its own fill
+// context from one RNTupleParallelWriter, which collects their clusters into
+// the single output file.
+
+#ifndef RNTUPLEOUTPUT_H
+#define RNTUPLEOUTPUT_H
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "RVersion.h"
+#include "EventRecord.h"
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,32,0)
+#define GENJETS_HAVE_RNTUPLE 1
+
+#include "ROOT/RNTupleModel.hxx"
+#include "ROOT/RNTupleParallelWriter.hxx"
+#include "ROOT/RNTupleWriteOptions.hxx"
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,35,0)
+namespace RNTupleAPI = ROOT;
+#else
+namespace RNTupleAPI = ROOT::Experimental;
+#endif
+
+class GenJetsNTupleFile {
+public:
+  // One worker's handle: copies the record into its entry on fill().
+  class Filler {
+  public:
+    Filler( RNTupleAPI::RNTupleParallelWriter & writer, GenJetsEvent & rec ) :
+      context_( writer.CreateFillContext() ), entry_( context_->CreateEntry() )
+    {
+      auto eventNum = entry_->GetPtr<ULong64_t>( "eventNum" );
+      auto weight = entry_->GetPtr<Double_t>( "weight" );
+      copies_.push_back( [eventNum, weight, &rec]() { *eventNum = rec.eventNum; *weight = rec.weight; } );
+      for ( Collection * coll : rec.collections() ) {
+	if ( !coll->enabled() ) continue;
+	auto n = entry_->GetPtr<Int_t>( coll->counter() );
+	copies_.push_back( [n, coll]() { *n = coll->size(); } );
+	for ( auto const & col : coll->columns() ) {
+	  if ( !col->write() ) continue;
+	  if ( !bind<Float_t>( col.get(), coll ) && !bind<Int_t>( col.get(), coll ) && !bind<JetColumns::TauRow>( col.get(), coll )
+	       && !bindRows<Float_t>( col.get(), coll ) && !bindRows<Int_t>( col.get(), coll ) ) bindRows<JetColumns::TauRow>( col.get(), coll );
+	}
+      }
+    }
+
+    void fill() {
+      for ( auto const & copy : copies_ ) copy();
+      context_->Fill( *entry_ );
+    }
+
+  protected :
+    template<class T> bool bind( ColumnBase * base, Collection * coll ) {
+      auto col = dynamic_cast<Column<T> *>( base );
+      if ( !col ) return false;
+      auto field = entry_->GetPtr<std::vector<T> >( col->name() );
+      copies_.push_back( [field, col, coll]() { field->assign( col->data(), col->data() + coll->size() ); } );
+      return true;
+    }
+
+    template<class T> bool bindRows( ColumnBase * base, Collection * coll ) {
+      auto col = dynamic_cast<RowColumn<T> *>( base );
+      if ( !col ) return false;
+      auto field = entry_->GetPtr<std::vector<std::vector<T> > >( col->name() );
+      copies_.push_back( [field, col, coll]() {
+	  field->resize( coll->size() );
+	  for ( Int_t i = 0; i < coll->size(); ++i ) (*field)[i].assign( (*col)[i], (*col)[i] + col->width() );
+	} );
+      return true;
+    }
+
+    std::shared_ptr<RNTupleAPI::RNTupleFillContext> context_;
+    std::unique_ptr<RNTupleAPI::REntry> entry_;
+    std::vector<std::function<void()> > copies_;
+  };
+
+  explicit GenJetsNTupleFile( std::string const & filename ) : filename_(filename) {}
+
+  // Thread safe. The first call creates the writer from rec's booked columns.
+  std::unique_ptr<Filler> filler( GenJetsEvent & rec ) {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    if ( !writer_ ) writer_ = RNTupleAPI::RNTupleParallelWriter::Recreate( makeModel( rec ), "T", filename_, options_ );
+    return std::unique_ptr<Filler>( new Filler( *writer_, rec ) );
+  }
+
+  RNTupleAPI::RNTupleWriteOptions & options() { return options_; }
+
+  // Fillers must be gone before this is called; it writes the footer.
+  void close() { writer_.reset(); }
+
+protected :
+  static std::unique_ptr<RNTupleAPI::RNTupleModel> makeModel( GenJetsEvent & rec ) {
+    auto model = RNTupleAPI::RNTupleModel::Create();
+    model->MakeField<ULong64_t>( "eventNum" );
+    model->MakeField<Double_t>( "weight" );
+    for ( Collection * coll : rec.collections() ) {
+      if ( !coll->enabled() ) continue;
+      model->MakeField<Int_t>( coll->counter() );
+      for ( auto const & col : coll->columns() ) {
+	if ( !col->write() ) continue;
+	if ( dynamic_cast<Column<Float_t> *>( col.get() ) ) model->MakeField<std::vector<Float_t> >( col->name() );
+	else if ( dynamic_cast<Column<Int_t> *>( col.get() ) ) model->MakeField<std::vector<Int_t> >( col->name() );
+	else if ( dynamic_cast<Column<JetColumns::TauRow> *>( col.get() ) ) model->MakeField<std::vector<JetColumns::TauRow> >( col->name() );
+	else if ( dynamic_cast<RowColumn<Float_t> *>( col.get() ) ) model->MakeField<std::vector<std::vector<Float_t> > >( col->name() );
+	else if ( dynamic_cast<RowColumn<Int_t> *>( col.get() ) ) model->MakeField<std::vector<std::vector<Int_t> > >( col->name() );
+	else model->MakeField<std::vector<std::vector<JetColumns::TauRow> > >( col->name() );
+      }
+    }
+    return model;
+  }
+
+  std::string filename_;
+  RNTupleAPI::RNTupleWriteOptions options_;
+  std::unique_ptr<RNTupleAPI::RNTupleParallelWriter> writer_;
+  std::mutex mutex_;
+};
+
+#else
+
+// RNTuple needs ROOT 6.32 or later; without it pythia2root refuses --format rntuple.
+class GenJetsNTupleFile {
+public:
+  struct Filler { void fill() {} };
+  explicit GenJetsNTupleFile( std::string const & ) {}
+  std::unique_ptr<Filler> filler( GenJetsEvent & ) { return nullptr; }
+  void close() {}
+};
+
+#endif
+
+#endif
@@ -0,0 +1,161 @@
+// RunStats.h
+// Per-stage timing and event counters for the event loops.
+//
+// The loop calls lap(stage) at the end of each stage; the time since the
+// previous lap is charged to that stage. That costs one clock read per
+// stage and the stages add up to the time spent in the loop. Stages that
+// run once per jet are charged once per jet. With several workers, each
+// has its own RunStats and they are merged at the end.
+//
+// printProgress() gives the periodic events/s line, print() the table at
+// the end of the run and writeJson() the same numbers for scripts.
+
+#ifndef RUNSTATS_H
+#define RUNSTATS_H
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+class RunStats {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  RunStats( std::vector<std::string> const & stages, unsigned long reportEvery = 0 ) :
+    stages_(stages), seconds_(stages.size(), 0.), calls_(stages.size(), 0), reportEvery_(reportEvery)
+  {
+    start();
+  }
+
+  // Restart the clocks, e.g. after initialization.
+  void start() {
+    last_ = lastReport_ = begin_ = Clock::now();
+    lastReportEvents_ = 0;
+  }
+
+  // Charge the time from now to the next lap, not since the previous one; e.g. at the
+  // start of a pipeline stage, so that the time between its events is not counted.
+  void skip() { last_ = Clock::now(); }
+
+  // Charge the time since the previous lap to stage.
+  void lap( unsigned int stage ) {
+    auto now = Clock::now();
+    seconds_[stage] += std::chrono::duration<double>( now - last_ ).count();
+    ++calls_[stage];
+    last_ = now;
+  }
+
+  // Event counters. generated + aborted is the number of pythia.next() calls.
+  unsigned long generated = 0;
+  unsigned long aborted = 0;
+  unsigned long accepted = 0;
+  unsigned long truncated = 0;          // accepted, but some jets or constituents were not stored
+  double initSeconds = 0.;              // pythia.init()
+  double initSavedSeconds = 0.;         // estimated init time saved by an InitCache
+
+  unsigned long events() const { return generated + aborted; }
+  double seconds( unsigned int stage ) const { return seconds_[stage]; }
+  double totalSeconds() const {
+    double total = 0.;
+    for ( auto s : seconds_ ) total += s;
+    return total;
+  }
+
+  // True every reportEvery events; call once per event.
+  bool progressDue() const { return reportEvery_ > 0 && events() > 0 && events() % reportEvery_ == 0; }
+
+  void printProgress( std::ostream & out, std::string const & label ) {
+    auto now = Clock::now();
+    double elapsed = std::chrono::duration<double>( now - begin_ ).count();
+    double recent = std::chrono::duration<double>( now - lastReport_ ).count();
+    char buff[1000];
+    sprintf( buff, " %s%lu events, %.1f events/s (last %lu: %.1f events/s), accepted %.1f%%",
+	     label.c_str(), events(), events() / elapsed, events() - lastReportEvents_,
+	     ( events() - lastReportEvents_ ) / recent, 100. * accepted / std::max( 1ul, generated ) );
+    out << buff << std::endl;
+    lastReport_ = now;
+    lastReportEvents_ = events();
+  }
+
+  void merge( RunStats const & o ) {
+    for ( size_t i = 0; i < seconds_.size(); ++i ) {
+      seconds_[i] += o.seconds_[i];
+      calls_[i] += o.calls_[i];
+    }
+    generated += o.generated;
+    aborted += o.aborted;
+    accepted += o.accepted;
+    truncated += o.truncated;
+    initSeconds += o.initSeconds;
+    initSavedSeconds += o.initSavedSeconds;
+  }
+
+  void print( std::ostream & out ) const {
+    double total = totalSeconds();
+    out << " RunStats: " << events() << " events: " << generated << " generated, " << aborted << " aborted, "
+	<< accepted << " accepted, " << truncated << " truncated" << std::endl;
+    char buff[1000];
+    if ( initSeconds > 0. ) {
+      sprintf( buff, "   %-16s %10.3f s, about %.3f s saved by the init cache", "init", initSeconds, initSavedSeconds );
+      out << buff << std::endl;
+    }
+    for ( size_t i = 0; i < stages_.size(); ++i ) {
+      sprintf( buff, "   %-16s %10.3f s %6.1f%% %10.1f us/event", stages_[i].c_str(), seconds_[i],
+	       total > 0 ? 100. * seconds_[i] / total : 0., events() > 0 ? 1e6 * seconds_[i] / events() : 0. );
+      out << buff << std::endl;
+    }
+  }
+
+  // Summary of the run; wallSeconds is the wall time of the whole program, all workers together.
+  void writeJson( std::string const & filename, std::string const & program, std::string const & config,
+		  unsigned int threads, double wallSeconds ) const {
+    std::ofstream out( filename );
+    out << "{\n";
+    out << "  \"program\": \"" << jsonEscape( program ) << "\",\n";
+    out << "  \"config\": \"" << jsonEscape( config ) << "\",\n";
+    out << "  \"threads\": " << threads << ",\n";
+    out << "  \"wall_seconds\": " << wallSeconds << ",\n";
+    out << "  \"events_per_second\": " << ( wallSeconds > 0 ? events() / wallSeconds : 0. ) << ",\n";
+    out << "  \"events\": { \"generated\": " << generated << ", \"aborted\": " << aborted
+	<< ", \"accepted\": " << accepted << ", \"truncated\": " << truncated << " },\n";
+    out << "  \"init\": { \"seconds\": " << initSeconds << ", \"saved_seconds\": " << initSavedSeconds << " },\n";
+    out << "  \"stages\": {\n";
+    for ( size_t i = 0; i < stages_.size(); ++i ) {
+      out << "    \"" << jsonEscape( stages_[i] ) << "\": { \"seconds\": " << seconds_[i] << ", \"calls\": " << calls_[i] << " }"
+	  << ( i + 1 < stages_.size() ? "," : "" ) << "\n";
+    }
+    out << "  }\n";
+    out << "}\n";
+  }
+
+protected :
+  // s with quotes, backslashes and control characters escaped for a JSON string.
+  static std::string jsonEscape( std::string const & s ) {
+    std::string escaped;
+    for ( char c : s ) {
+      if ( c == '"' || c == '\\' ) {
+	escaped += '\\';
+	escaped += c;
+      } else if ( (unsigned char)c < 0x20 ) {
+	char buff[8];
+	sprintf( buff, "\\u%04x", c );
+	escaped += buff;
+      } else {
+	escaped += c;
+      }
+    }
+    return escaped;
+  }
+
+  std::vector<std::string> stages_;
+  std::vector<double> seconds_;
+  std::vector<unsigned long> calls_;
+  unsigned long reportEvery_;
+  Clock::time_point begin_, last_, lastReport_;
+  unsigned long lastReportEvents_ = 0;
+};
+
+#endif
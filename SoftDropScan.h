@@ -0,0 +1,82 @@
+// SoftDropScan.h
+// SoftDrop grooming of each jet at several (z_cut, beta) points.
+//
+// fastjet::contrib::SoftDrop reclusters every jet it is given with
+// Cambridge/Aachen before declustering it. SoftDropScan reclusters a jet
+// once and declusters that one C/A history with a SoftDrop per grooming
+// point, so a scan of n points costs one reclustering instead of n.
+// Point 0 is the main grooming (--sd-zcut, --sd-beta) behind jet_msd and
+// the subjet and _sd branches; the scan points are given with --sd-scan as
+//     z_cut:beta,z_cut:beta,...
+// and fill the <prefix>_sdscan_* branches, one value per point.
+
+#ifndef SOFTDROPSCAN_H
+#define SOFTDROPSCAN_H
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "fastjet/PseudoJet.hh"
+#include "fastjet/tools/Recluster.hh"
+#include "fastjet/contrib/SoftDrop.hh"
+
+struct GroomingPoint {
+  double zcut;
+  double beta;
+
+  // Parse a comma-separated list of z_cut:beta; returns false if any entry is malformed.
+  static bool parse( std::string const & list, std::vector<GroomingPoint> & points ) {
+    points.clear();
+    std::stringstream ss( list );
+    std::string entry;
+    while ( std::getline( ss, entry, ',' ) ) {
+      if ( entry == "" ) continue;
+      size_t colon = entry.find( ':' );
+      if ( colon == std::string::npos || colon == 0 || colon + 1 == entry.size() ) {
+	std::cout << "GroomingPoint: cannot parse " << entry << ", expected z_cut:beta" << std::endl;
+	return false;
+      }
+      points.push_back( GroomingPoint{ std::atof( entry.substr( 0, colon ).c_str() ), std::atof( entry.substr( colon + 1 ).c_str() ) } );
+    }
+    return true;
+  }
+};
+
+class SoftDropScan {
+public:
+  SoftDropScan( GroomingPoint const & main, std::vector<GroomingPoint> const & scan ) :
+    recluster_( fastjet::cambridge_algorithm, fastjet::JetDefinition::max_allowable_R )
+  {
+    points_.push_back( main );
+    points_.insert( points_.end(), scan.begin(), scan.end() );
+    for ( auto const & point : points_ ) {
+      groomers_.emplace_back( point.beta, point.zcut );
+      groomers_.back().set_reclustering( false );   // groom() hands them the C/A jet
+    }
+    groomed_.resize( points_.size() );
+  }
+
+  // Recluster jet with C/A and groom it at every point.
+  void groom( fastjet::PseudoJet const & jet ) {
+    ca_ = recluster_( jet );
+    for ( size_t i = 0; i < groomers_.size(); ++i ) groomed_[i] = groomers_[i]( ca_ );
+  }
+
+  // The jet groomed at the main point, and at scan point i, from the last groom().
+  fastjet::PseudoJet const & main() const { return groomed_[0]; }
+  fastjet::PseudoJet const & scanned( size_t i ) const { return groomed_[i+1]; }
+  size_t nScan() const { return points_.size() - 1; }
+  GroomingPoint const & scanPoint( size_t i ) const { return points_[i+1]; }
+
+protected :
+  fastjet::Recluster recluster_;
+  std::vector<GroomingPoint> points_;
+  std::vector<fastjet::contrib::SoftDrop> groomers_;
+  fastjet::PseudoJet ca_;
+  std::vector<fastjet::PseudoJet> groomed_;
+};
+
+#endif
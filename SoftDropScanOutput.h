@@ -0,0 +1,47 @@
+// SoftDropScanOutput.h
+// The "SoftDropScan" tree of the output file, one entry per scan point, so
+// that the _sdscan_ branches can be matched to their z_cut and beta. Kept
+// apart from SoftDropScan.h, which only needs FastJet.
+
+#ifndef SOFTDROPSCANOUTPUT_H
+#define SOFTDROPSCANOUTPUT_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "TFile.h"
+#include "TTree.h"
+
+#include "SoftDropScan.h"
+
+struct SoftDropScanOutput {
+  // Add the tree to an existing file.
+  static bool write( std::string const & filename, std::vector<GroomingPoint> const & scan ) {
+    TFile * file = TFile::Open( filename.c_str(), "update" );
+    if ( !file || file->IsZombie() ) {
+      std::cout << "SoftDropScan: cannot update " << filename << std::endl;
+      return false;
+    }
+    write( file, scan );
+    file->Close();
+    delete file;
+    return true;
+  }
+
+  static void write( TFile * file, std::vector<GroomingPoint> const & scan ) {
+    file->cd();
+    Double_t zcut = 0., beta = 0.;
+    TTree * points = new TTree( "SoftDropScan", "Grooming points of the _sdscan_ branches" );
+    points->Branch( "zcut", &zcut, "zcut/D" );
+    points->Branch( "beta", &beta, "beta/D" );
+    for ( auto const & point : scan ) {
+      zcut = point.zcut;
+      beta = point.beta;
+      points->Fill();
+    }
+    points->Write();
+  }
+};
+
+#endif
@@ -0,0 +1,26 @@
+#!/bin/bash
+# Compare the branch tuning presets of pythia2root on a fixed-seed
+# gravkk_zz_1TeV.cfg sample: time spent in the writer, bytes per event and
+# columnar read speed with uproot. Extra arguments are passed to every run,
+# e.g. --auto-flush 5000 or --precision angles=10.
+#
+# usage: bash benchmark_compression.sh [n_events] [seed] [options...]
+
+NEVENTS=${1:-10000}
+SEED=${2:-12345}
+shift $(( $# < 2 ? $# : 2 ))
+PRESETS="default fast balanced archive compact"
+
+for preset in ${PRESETS}; do
+    out=benchmark_${preset}.root
+    start=$(date +%s.%N)
+    ./pythia2root --compression ${preset} "$@" gravkk_zz_1TeV.cfg ${out} ${NEVENTS} ${SEED} 30 > benchmark_${preset}.log 2>&1
+    end=$(date +%s.%N)
+    entries=$(grep -o 'Output (tree): [0-9]*' benchmark_${preset}.log | awk '{ n += $3 } END { print n }')
+    writer=$(grep -o 'entries, [0-9.e+-]* s in the writer' benchmark_${preset}.log | awk '{ s += $2 } END { print s }')
+    bytes=$(stat -c %s ${out})
+    printf "%-9s writer %8.2f s (%8.0f events/s)  total %8.2f s  %10d bytes  %8.0f bytes/event\n" \
+	${preset} ${writer} $(echo "${entries} / ${writer}" | bc -l) $(echo "${end} - ${start}" | bc) ${bytes} $(echo "${bytes} / ${entries}" | bc -l)
+done
+
+python3 benchmark_read.py $(for preset in ${PRESETS}; do echo benchmark_${preset}.root; done)
@@ -0,0 +1,75 @@
+// benchmark_kinematics.cc
+// Time the pt, eta and phi of the constituent_* columns: one Particle at a
+// time, as ParticleColumns::push() does, against the batch of
+// BatchKinematics.h. Also checks that both give the same floats.
+//
+// usage: ./benchmark_kinematics [n_particles] [n_repeats]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "Pythia8/Pythia.h"
+#include "BatchKinematics.h"
+
+typedef std::chrono::steady_clock Clock;
+
+int main( int argc, char * argv[] ) {
+  size_t n = argc > 1 ? std::atol( argv[1] ) : 1000;   // about one event
+  int repeats = argc > 2 ? std::atoi( argv[2] ) : 2000;
+
+  // Pions with a falling pt spectrum, flat in eta and phi.
+  Pythia8::Rndm rndm;
+  rndm.init( 12345 );
+  std::vector<Pythia8::Particle> particles;
+  for ( size_t i = 0; i < n; ++i ) {
+    double pt = -2.0 * std::log( rndm.flat() );
+    double eta = 10.0 * rndm.flat() - 5.0;
+    double phi = 2.0 * M_PI * rndm.flat() - M_PI;
+    double m = 0.13957;
+    double px = pt * std::cos( phi ), py = pt * std::sin( phi ), pz = pt * std::sinh( eta );
+    particles.emplace_back( 211, 1, 0, 0, 0, 0, 0, 0, px, py, pz, std::sqrt( px*px + py*py + pz*pz + m*m ), m );
+  }
+
+  std::vector<float> pt( n ), eta( n ), phi( n );
+  KinematicsBatch batch;
+  double bestScalar = 1e30, bestBatch = 1e30;
+  for ( int r = 0; r < repeats; ++r ) {
+    auto t0 = Clock::now();
+    for ( size_t i = 0; i < n; ++i ) {
+      auto const & p = particles[i];
+      pt[i] = p.pT();
+      eta[i] = p.eta();
+      phi[i] = p.phi();
+    }
+    auto t1 = Clock::now();
+    batch.clear();
+    for ( size_t i = 0; i < n; ++i ) {
+      auto const & p = particles[i];
+      batch.add( p.px(), p.py(), p.pz(), p.e(), i );
+    }
+    batch.compute();
+    auto t2 = Clock::now();
+    bestScalar = std::min( bestScalar, std::chrono::duration<double, std::nano>( t1 - t0 ).count() );
+    bestBatch = std::min( bestBatch, std::chrono::duration<double, std::nano>( t2 - t1 ).count() );
+  }
+
+  // Largest difference in units of the float spacing at the value.
+  double worst = 0.;
+  for ( size_t i = 0; i < n; ++i ) {
+    for ( auto d : { std::make_pair( pt[i], batch.pt[i] ), std::make_pair( eta[i], batch.eta[i] ), std::make_pair( phi[i], batch.phi[i] ) } ) {
+      double ulp = std::nextafter( std::fabs( d.first ), 1e30f ) - std::fabs( d.first );
+      worst = std::max( worst, std::fabs( double( d.first ) - d.second ) / ulp );
+    }
+  }
+
+  std::cout << n << " particles, best of " << repeats << std::endl;
+  std::cout << "  per particle : " << bestScalar / n << " ns/particle" << std::endl;
+  std::cout << "  batch        : " << bestBatch / n << " ns/particle (gather included)" << std::endl;
+  std::cout << "  speedup      : " << bestScalar / bestBatch << std::endl;
+  std::cout << "  largest difference: " << worst << " float ulp" << std::endl;
+  return 0;
+}
@@ -0,0 +1,41 @@
+#!/usr/bin/env python3
+"""Time loading the jets of a pythia2root output into pandas.
+
+usage: python3 benchmark_pandas.py file.root|file.parquet [...]
+
+A ROOT file is read with uproot and flattened with awkward, the way the
+notebooks do; a Parquet file is read with pandas.read_parquet and its list
+columns are exploded. Either way the result is one row per jet. Prints the
+best of a few repeats per file.
+"""
+import sys
+import time
+
+import pandas as pd
+
+COLUMNS = ["jet_pt", "jet_eta", "jet_phi", "jet_m", "jet_msd", "jet_nc"]
+REPEAT = 3
+
+
+def load_root(filename):
+    import awkward as ak
+    import uproot
+
+    with uproot.open(filename) as f:
+        return ak.to_dataframe(f["T"].arrays(COLUMNS))
+
+
+def load_parquet(filename):
+    df = pd.read_parquet(filename, columns=COLUMNS)
+    return df.explode(COLUMNS).dropna()
+
+
+for filename in sys.argv[1:]:
+    load = load_parquet if filename.endswith(".parquet") else load_root
+    best = None
+    for _ in range(REPEAT):
+        start = time.perf_counter()
+        df = load(filename)
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+    print("%-30s %8d jets  load %.3f s  (%.0f jets/s)" % (filename, len(df), best, len(df) / best))
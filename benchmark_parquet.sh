@@ -0,0 +1,26 @@
+#!/bin/bash
+# Compare the TTree and Parquet outputs of pythia2root on a fixed-seed
+# gravkk_zz_1TeV.cfg sample: time spent in the writer, file size and the
+# time to load the jets into a pandas DataFrame.
+#
+# usage: bash benchmark_parquet.sh [n_events] [seed] [parquet options...]
+# e.g.   bash benchmark_parquet.sh 10000 12345 --row-group 5000 --arrow-compression zstd:3
+
+NEVENTS=${1:-10000}
+SEED=${2:-12345}
+shift $(( $# < 2 ? $# : 2 ))
+OPTIONS="$@"
+
+for format in tree parquet; do
+    out=benchmark_${format}.root
+    [ ${format} == parquet ] && out=benchmark.parquet
+    opts="--format ${format}"
+    [ ${format} == parquet ] && opts="${opts} ${OPTIONS}"
+    start=$(date +%s.%N)
+    ./pythia2root ${opts} gravkk_zz_1TeV.cfg ${out} ${NEVENTS} ${SEED} 30 > benchmark_${format}.log 2>&1
+    end=$(date +%s.%N)
+    echo "${format}: $(grep 'Output (' benchmark_${format}.log)"
+    echo "${format}: total $(echo "${end} - ${start}" | bc) s, $(stat -c %s ${out}) bytes"
+done
+
+python3 benchmark_pandas.py benchmark_tree.root benchmark.parquet
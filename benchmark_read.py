@@ -0,0 +1,38 @@
+#!/usr/bin/env python3
+"""Time columnar reads of the "T" tree or RNTuple written by pythia2root.
+
+usage: python3 benchmark_read.py file.root [file.root ...]
+
+Reads the jet, gen and constituent kinematics with uproot, the way the
+notebooks do, a few times per file and prints the best time.
+"""
+import sys
+import time
+
+import uproot
+
+COLUMNS = [
+    "jet_pt", "jet_eta", "jet_phi", "jet_m", "jet_msd", "jet_nc",
+    "gen_pt", "gen_eta", "gen_phi", "gen_m", "gen_id",
+    "constituent_pt", "constituent_eta", "constituent_phi", "constituent_m", "constituent_jetndx",
+]
+REPEAT = 3
+
+
+def read(filename):
+    with uproot.open(filename) as f:
+        t = f["T"]
+        columns = [c for c in COLUMNS if c in t.keys()]
+        arrays = t.arrays(columns)
+        return len(arrays), len(columns)
+
+
+for filename in sys.argv[1:]:
+    best = None
+    for _ in range(REPEAT):
+        start = time.perf_counter()
+        nevents, ncolumns = read(filename)
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+    print("%-30s %8d events %3d columns  read %.3f s  (%.0f events/s)"
+          % (filename, nevents, ncolumns, best, nevents / best))
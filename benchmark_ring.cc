@@ -0,0 +1,87 @@
+// benchmark_ring.cc
+// Throughput of the shared-memory EventRing: one producer thread publishes
+// events of a fixed size as fast as it can, and consumer threads, each
+// attached as its own consumer, read them. Prints events/s and GB/s of the
+// producer, and what every consumer received, lost and checked.
+//
+// usage: ./benchmark_ring [n_events] [event_bytes] [n_consumers] [policy] [n_slots]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "EventRing.h"
+
+typedef std::chrono::steady_clock Clock;
+
+int main( int argc, char * argv[] ) {
+  unsigned long n = argc > 1 ? std::atol( argv[1] ) : 1000000;
+  size_t bytes = argc > 2 ? std::atol( argv[2] ) : 16384;      // about an event with constituents
+  unsigned int nConsumers = argc > 3 ? std::atoi( argv[3] ) : 2;
+  std::string policyName = argc > 4 ? argv[4] : "block";
+  unsigned long nSlots = argc > 5 ? std::atol( argv[5] ) : 256;
+  EventRingWriter::Policy policy;
+  if ( !EventRingWriter::parsePolicy( policyName, policy ) ) return 1;
+  if ( bytes < 20 ) bytes = 20;
+
+  // One collection with one float column, filling the rest of the event.
+  std::string name = "/benchmark_ring." + std::to_string( getpid() );
+  EventRingWriter writer( name, nSlots, bytes, policy );
+  if ( !writer.good() ) return 1;
+  writer.setSchema( "@nJet\njet_pt F 4 \n" );
+  int32_t nValues = ( bytes - 20 ) / 4;
+  std::vector<char> event( 20 + nValues * 4 );
+  std::memcpy( event.data() + 16, &nValues, 4 );
+
+  // The consumers check that each event is whole: every value is the eventNum.
+  std::vector<unsigned long> received( nConsumers, 0 ), lost( nConsumers, 0 ), bad( nConsumers, 0 );
+  std::atomic<unsigned int> attached( 0 );
+  std::vector<std::thread> consumers;
+  for ( unsigned int ic = 0; ic < nConsumers; ++ic ) {
+    consumers.emplace_back( [&, ic]() {
+	EventRingReader reader( name );
+	++attached;
+	if ( !reader.good() ) return;
+	EventRingEvent ev;
+	while ( reader.next( ev ) ) {
+	  int m = 0;
+	  float const * values = ev.column<float>( "jet_pt", m );
+	  if ( m != nValues || values[0] != float( ev.eventNum ) || values[m-1] != float( ev.eventNum ) ) ++bad[ic];
+	  ++received[ic];
+	}
+	lost[ic] = reader.lost();
+      } );
+  }
+  while ( attached < nConsumers ) std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+
+  auto start = Clock::now();
+  unsigned long published = 0;
+  for ( uint64_t i = 0; i < n; ++i ) {
+    std::memcpy( event.data(), &i, 8 );
+    float value = i;
+    float * values = reinterpret_cast<float *>( event.data() + 20 );
+    for ( int32_t j = 0; j < nValues; ++j ) values[j] = value;
+    if ( writer.publish( event.data(), event.size() ) ) ++published;
+  }
+  double seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+  writer.close();
+  for ( auto & consumer : consumers ) consumer.join();
+
+  char buff[1000];
+  sprintf( buff, "%lu events of %zu bytes, %u consumers, policy %s, %lu slots", n, event.size(), nConsumers, policyName.c_str(), nSlots );
+  std::cout << buff << std::endl;
+  sprintf( buff, "  producer  %10lu published  %12.0f events/s  %8.3f GB/s", published, published / seconds, published * event.size() / seconds / 1e9 );
+  std::cout << buff << std::endl;
+  writer.print( std::cout );
+  for ( unsigned int ic = 0; ic < nConsumers; ++ic ) {
+    sprintf( buff, "  consumer %u %10lu received  %10lu lost  %lu torn", ic, received[ic], lost[ic], bad[ic] );
+    std::cout << buff << std::endl;
+  }
+  return 0;
+}
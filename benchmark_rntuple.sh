@@ -0,0 +1,20 @@
+#!/bin/bash
+# Compare the TTree and RNTuple outputs of pythia2root on a fixed-seed
+# gravkk_zz_1TeV.cfg sample: time spent in the writer, file size and
+# columnar read speed with uproot.
+#
+# usage: bash benchmark_rntuple.sh [n_events] [seed]
+
+NEVENTS=${1:-10000}
+SEED=${2:-12345}
+
+for format in tree rntuple; do
+    out=benchmark_${format}.root
+    start=$(date +%s.%N)
+    ./pythia2root --format ${format} gravkk_zz_1TeV.cfg ${out} ${NEVENTS} ${SEED} 30 > benchmark_${format}.log 2>&1
+    end=$(date +%s.%N)
+    echo "${format}: $(grep 'Output (' benchmark_${format}.log)"
+    echo "${format}: total $(echo "${end} - ${start}" | bc) s, $(stat -c %s ${out}) bytes"
+done
+
+python3 benchmark_read.py benchmark_tree.root benchmark_rntuple.root
@@ -0,0 +1,96 @@
+"""Generate jets in the Python process, in batches of NumPy or Awkward arrays.
+
+    import genjets
+    source = genjets.BatchSource("qcd_multijets.cfg", seed=1, jets="jet:antikt:0.8:170")
+    for events in genjets.batches(source, 1000, n_batches=10, prefetch=2):
+        events.jet.pt, events.jet.msd, events.jet.tau[:, :, 1, 0], events.jet.constituent.pt
+
+BatchSource and EventBatch come from the C++ module genjets_cpp (make
+genjets_cpp). The arrays are views of the C++ buffers of each batch, so
+nothing is copied and no ROOT file is written. The field names are those of
+the pythia2root branches without the prefix: events.jet.pt is jet_pt.
+"""
+import queue
+import threading
+
+from genjets_cpp import BatchSource, EventBatch
+
+__all__ = ["BatchSource", "EventBatch", "to_awkward", "batches"]
+
+
+def to_awkward(batch):
+    """Wrap the columns of an EventBatch in an Awkward array, without copying them."""
+    import awkward as ak
+
+    arrays = batch.arrays()
+
+    def numpy(name):
+        return ak.contents.NumpyArray(arrays[name])
+
+    def jagged(offsets, names, fields):
+        record = ak.contents.RecordArray([numpy(n) for n in names], fields)
+        return ak.contents.ListOffsetArray(ak.index.Index64(arrays[offsets]), record)
+
+    names = ["eventNum", "weight"]
+    contents = [numpy("eventNum"), numpy("weight")]
+    for prefix in batch.prefixes:
+        p = prefix + "_"
+        fields = [f for f in ("pt", "eta", "phi", "m", "msd", "nc", "tau", "tau_sd", "sdscan_msd")
+                  if p + f in arrays]
+        jets = ak.contents.RecordArray(
+            [numpy(p + f) for f in fields]
+            + [jagged(p + "constituent_offsets",
+                      [p + "constituent_" + f for f in ("pt", "eta", "phi", "m", "id")],
+                      ["pt", "eta", "phi", "m", "id"])],
+            fields + ["constituent"])
+        names.append(prefix)
+        contents.append(ak.contents.ListOffsetArray(ak.index.Index64(arrays[p + "offsets"]), jets))
+    return ak.Array(ak.contents.RecordArray(contents, names, length=len(batch)))
+
+
+def batches(source, batch_size, n_batches=None, prefetch=0, awkward=True):
+    """Yield batches of batch_size events from source, as Awkward arrays or
+    (awkward=False) as the EventBatch itself.
+
+    Stops after n_batches, or when source has generated its n_events. With
+    prefetch > 0 a thread generates up to prefetch batches ahead; the GIL is
+    released while it runs Pythia, so the caller keeps working meanwhile.
+    """
+    def generate():
+        n = 0
+        while n_batches is None or n < n_batches:
+            batch = source.next_batch(batch_size)
+            if len(batch) == 0:
+                return
+            n += 1
+            yield batch
+
+    convert = to_awkward if awkward else (lambda batch: batch)
+    if prefetch <= 0:
+        for batch in generate():
+            yield convert(batch)
+        return
+
+    done = object()
+    ready = queue.Queue(maxsize=prefetch)
+    errors = []
+
+    def produce():
+        try:
+            for batch in generate():
+                ready.put(batch)
+        except Exception as error:
+            errors.append(error)
+        finally:
+            ready.put(done)
+
+    thread = threading.Thread(target=produce, daemon=True)
+    thread.start()
+    while True:
+        batch = ready.get()
+        if batch is done:
+            break
+        yield convert(batch)
+    thread.join()
+    if errors:
+        raise errors[0]
@@ -0,0 +1,302 @@
+// genjets_cpp.cc
+// Python module genjets_cpp: generate events and cluster, groom and measure
+// their jets inside the Python process, in batches, without ROOT I/O.
+//
+// A BatchSource runs the stages of pythia2root (Generator.h,
+// ParticleSelector.h, JetCollections.h and JetSubstructure.h).
+// next_batch(n) fills an EventBatch with n events that have a jet. Its
+// columns are flat structure-of-arrays buffers: one entry per event, per
+// jet of a collection, or per constituent of those jets, with offsets from
+// each level to the next. Pythia runs with the GIL
+// released, so a data loader thread can generate while the training loop
+// runs. EventBatch.arrays() gives NumPy views of the buffers. They hold a
+// reference to the batch instead of a copy; genjets.py wraps the same
+// buffers in Awkward arrays.
+//
+// Build with "make genjets_cpp"; see README.md.
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include "Generator.h"
+#include "ParticleSelector.h"
+#include "JetCollections.h"
+#include "JetSubstructure.h"
+
+namespace py = pybind11;
+
+// The columns of one jet collection. The jets of event i are
+// offsets[i] ... offsets[i+1]-1, the constituents of jet j are
+// constituent_offsets[j] ... constituent_offsets[j+1]-1.
+struct JetBatchColumns {
+  std::string prefix;
+  std::vector<int64_t> offsets{ 0 };
+  std::vector<float> pt, eta, phi, m, msd;
+  std::vector<int32_t> nc;
+  std::vector<float> tau, tau_sd;           // [jet][N-1][ibeta]
+  std::vector<float> sdscan_msd;            // [jet][point]
+  std::vector<int64_t> constituent_offsets{ 0 };
+  std::vector<float> constituent_pt, constituent_eta, constituent_phi, constituent_m;
+  std::vector<int32_t> constituent_id;
+};
+
+struct EventBatch {
+  std::vector<int64_t> eventNum;
+  std::vector<double> weight;
+  std::vector<JetBatchColumns> jets;        // one per collection
+  unsigned int maxN = 0, nBeta = 0, nScan = 0;
+  unsigned long generated = 0;              // pythia.next() calls that succeeded ...
+  unsigned long aborted = 0;                // ... and that failed, for this batch
+
+  size_t size() const { return eventNum.size(); }
+};
+
+struct BatchOptions {
+  std::string configfile;
+  long seed = -1;
+  std::string jets = "jet:antikt:0.8:170";
+  double sdZcut = 0.10, sdBeta = 0.0;
+  std::string sdScan;
+  unsigned int maxN = 4;
+  std::vector<double> betas{ 1.0 };
+  double lepfrac = 0.9;
+  bool constituents = true;
+  bool skipEmpty = true;                    // only events with a jet, as pythia2root writes them
+  bool eventSeeds = false;
+  unsigned long firstEvent = 0;
+  unsigned long nEvents = 0;                // events to generate in total, 0 = no limit
+  std::string initCacheDir;
+};
+
+class BatchSource {
+public:
+  explicit BatchSource( BatchOptions const & opt ) :
+    opt_(opt),
+    specs_(JetSpec::parse( opt.jets )),
+    clusterer_(specs_),
+    substructure_(GroomingPoint{ opt.sdZcut, opt.sdBeta }, scanPoints( opt.sdScan ), opt.maxN, opt.betas, opt.lepfrac)
+  {
+    if ( specs_.empty() ) throw std::invalid_argument( "bad jets specification " + opt.jets );
+    if ( opt.maxN == 0 || opt.betas.empty() ) throw std::invalid_argument( "need max_n > 0 and at least one beta" );
+    generator_.configure( opt.configfile, opt.seed );
+    if ( opt.eventSeeds ) generator_.useEventSeeds( opt.seed < 0 ? 19780503 : opt.seed );
+    if ( !generator_.init( opt.initCacheDir, std::to_string( getpid() ) ) )
+      throw std::runtime_error( "Pythia initialization failed for " + opt.configfile );
+  }
+
+  // Generate until batch has n events, or nEvents have been generated.
+  void fill( EventBatch & batch, size_t n ) {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    batch.maxN = substructure_.maxN();
+    batch.nBeta = substructure_.betas().size();
+    batch.nScan = substructure_.groomer().nScan();
+    batch.jets.resize( clusterer_.size() );
+    for ( size_t icoll = 0; icoll < clusterer_.size(); ++icoll ) batch.jets[icoll].prefix = specs_[icoll].prefix;
+    reserve( batch, n );
+    Pythia8::Event const & event = generator_.pythia.event;
+    while ( batch.size() < n && ( opt_.nEvents == 0 || iEvent_ < opt_.nEvents ) ) {
+      uint64_t eventNum = opt_.firstEvent + iEvent_++;
+      if ( !generator_.next( eventNum ) ) {
+	++batch.aborted;
+	continue;
+      }
+      ++batch.generated;
+      selector_.clear();
+      particleId_.resize( event.size() );
+      // As in pythia2root: the generator-level particles are not clustered.
+      selector_.addEvent( event, []( Pythia8::Particle const &, int ) {},
+			  [this]( Pythia8::Particle const & p, int i ) { particleId_[i] = p.id(); } );
+      selector_.select( particles_ );
+      clusterer_.cluster( particles_ );
+      bool stored = false;
+      for ( size_t icoll = 0; icoll < clusterer_.size(); ++icoll ) {
+	for ( auto const & jet : clusterer_.jets( icoll ) ) stored = addJet( batch.jets[icoll], jet ) || stored;
+      }
+      if ( !stored && opt_.skipEmpty ) continue;
+      batch.eventNum.push_back( eventNum );
+      batch.weight.push_back( generator_.pythia.info.weight() );
+      for ( auto & c : batch.jets ) c.offsets.push_back( c.pt.size() );
+    }
+    finish( batch );
+  }
+
+  unsigned long eventsGenerated() const { return iEvent_; }
+  Generator & generator() { return generator_; }
+
+protected :
+  static std::vector<GroomingPoint> scanPoints( std::string const & list ) {
+    std::vector<GroomingPoint> points;
+    if ( list != "" && !GroomingPoint::parse( list, points ) ) throw std::invalid_argument( "bad sd_scan " + list );
+    return points;
+  }
+
+  // Append jet to c, unless it is mostly leptons (as in pythia2root).
+  bool addJet( JetBatchColumns & c, fastjet::PseudoJet const & jet ) {
+    auto constituents = jet.constituents();
+    if ( !substructure_.accept( jet, constituents, particleId_ ) ) return false;
+
+    substructure_.groom( jet );
+    SoftDropScan const & sd = substructure_.groomer();
+    c.pt.push_back( jet.perp() );
+    c.eta.push_back( jet.eta() );
+    c.phi.push_back( jet.phi() );
+    c.m.push_back( jet.m() );
+    c.msd.push_back( sd.main().m() );
+    c.nc.push_back( constituents.size() );
+    substructure_.taus( jet, [&c]( unsigned int, unsigned int, double tau ) { c.tau.push_back( tau ); } );
+    substructure_.taus( sd.main(), [&c]( unsigned int, unsigned int, double tau ) { c.tau_sd.push_back( tau ); } );
+    for ( size_t ip = 0; ip < sd.nScan(); ++ip ) c.sdscan_msd.push_back( sd.scanned( ip ).m() );
+    if ( opt_.constituents ) {
+      for ( auto const & con : fastjet::sorted_by_pt( constituents ) ) {
+	c.constituent_pt.push_back( con.perp() );
+	c.constituent_eta.push_back( con.eta() );
+	c.constituent_phi.push_back( con.phi() );
+	c.constituent_m.push_back( con.m() );
+	c.constituent_id.push_back( particleId_[con.user_index()] );
+      }
+    }
+    c.constituent_offsets.push_back( c.constituent_pt.size() );
+    return true;
+  }
+
+  // Size a new batch like the last one, so that its buffers are not regrown event by event.
+  void reserve( EventBatch & batch, size_t n ) {
+    batch.eventNum.reserve( n );
+    batch.weight.reserve( n );
+    for ( size_t icoll = 0; icoll < batch.jets.size(); ++icoll ) {
+      JetBatchColumns & c = batch.jets[icoll];
+      size_t nJet = n * jetsPerEvent_[icoll] + n;
+      size_t nCon = nJet * constituentsPerJet_[icoll];
+      for ( auto v : { &c.pt, &c.eta, &c.phi, &c.m, &c.msd } ) v->reserve( nJet );
+      c.nc.reserve( nJet );
+      c.constituent_offsets.reserve( nJet + 1 );
+      c.tau.reserve( nJet * substructure_.maxN() * substructure_.betas().size() );
+      c.tau_sd.reserve( nJet * substructure_.maxN() * substructure_.betas().size() );
+      for ( auto v : { &c.constituent_pt, &c.constituent_eta, &c.constituent_phi, &c.constituent_m } ) v->reserve( nCon );
+      c.constituent_id.reserve( nCon );
+    }
+  }
+
+  // Remember the sizes of this batch for reserve().
+  void finish( EventBatch const & batch ) {
+    for ( size_t icoll = 0; icoll < batch.jets.size(); ++icoll ) {
+      JetBatchColumns const & c = batch.jets[icoll];
+      if ( batch.size() > 0 ) jetsPerEvent_[icoll] = double( c.pt.size() ) / batch.size();
+      if ( c.pt.size() > 0 ) constituentsPerJet_[icoll] = double( c.constituent_pt.size() ) / c.pt.size();
+    }
+  }
+
+  BatchOptions opt_;
+  std::vector<JetSpec> specs_;
+  Generator generator_;
+  ParticleSelector selector_;
+  JetClusterer clusterer_;
+  JetSubstructure substructure_;
+  std::vector<fastjet::PseudoJet> particles_;
+  std::vector<int> particleId_;
+  std::vector<double> jetsPerEvent_ = std::vector<double>( specs_.size(), 1. );
+  std::vector<double> constituentsPerJet_ = std::vector<double>( specs_.size(), 30. );
+  unsigned long iEvent_ = 0;
+  std::mutex mutex_;
+};
+
+// A NumPy array over v that keeps owner (the EventBatch) alive instead of copying v.
+template<class T>
+py::array view( std::vector<T> const & v, std::vector<py::ssize_t> const & shape, py::handle owner ) {
+  return py::array_t<T>( shape, v.data(), owner );
+}
+
+PYBIND11_MODULE( genjets_cpp, m ) {
+  m.doc() = "Pythia events, clustered, groomed and measured in-process, as batches of NumPy columns";
+
+  py::class_<EventBatch, std::shared_ptr<EventBatch> >( m, "EventBatch" )
+    .def( "__len__", &EventBatch::size )
+    .def_readonly( "generated", &EventBatch::generated )
+    .def_readonly( "aborted", &EventBatch::aborted )
+    .def_property_readonly( "prefixes", []( EventBatch const & b ) {
+	std::vector<std::string> prefixes;
+	for ( auto const & c : b.jets ) prefixes.push_back( c.prefix );
+	return prefixes;
+      } )
+    // Column name -> NumPy view: eventNum, weight and, for every collection,
+    // <prefix>_offsets, <prefix>_pt ... and <prefix>_constituent_offsets, <prefix>_constituent_pt ...
+    .def( "arrays", []( py::object self ) {
+	EventBatch const & b = self.cast<EventBatch const &>();
+	py::dict arrays;
+	py::ssize_t nEvent = b.size();
+	arrays["eventNum"] = view( b.eventNum, { nEvent }, self );
+	arrays["weight"] = view( b.weight, { nEvent }, self );
+	py::ssize_t nTau = b.maxN, nBeta = b.nBeta, nScan = b.nScan;
+	for ( auto const & c : b.jets ) {
+	  std::string p = c.prefix + "_";
+	  py::ssize_t nJet = c.pt.size(), nCon = c.constituent_pt.size();
+	  arrays[( p + "offsets" ).c_str()] = view( c.offsets, { nEvent + 1 }, self );
+	  arrays[( p + "pt" ).c_str()] = view( c.pt, { nJet }, self );
+	  arrays[( p + "eta" ).c_str()] = view( c.eta, { nJet }, self );
+	  arrays[( p + "phi" ).c_str()] = view( c.phi, { nJet }, self );
+	  arrays[( p + "m" ).c_str()] = view( c.m, { nJet }, self );
+	  arrays[( p + "msd" ).c_str()] = view( c.msd, { nJet }, self );
+	  arrays[( p + "nc" ).c_str()] = view( c.nc, { nJet }, self );
+	  arrays[( p + "tau" ).c_str()] = view( c.tau, { nJet, nTau, nBeta }, self );
+	  arrays[( p + "tau_sd" ).c_str()] = view( c.tau_sd, { nJet, nTau, nBeta }, self );
+	  if ( nScan > 0 ) arrays[( p + "sdscan_msd" ).c_str()] = view( c.sdscan_msd, { nJet, nScan }, self );
+	  arrays[( p + "constituent_offsets" ).c_str()] = view( c.constituent_offsets, { nJet + 1 }, self );
+	  arrays[( p + "constituent_pt" ).c_str()] = view( c.constituent_pt, { nCon }, self );
+	  arrays[( p + "constituent_eta" ).c_str()] = view( c.constituent_eta, { nCon }, self );
+	  arrays[( p + "constituent_phi" ).c_str()] = view( c.constituent_phi, { nCon }, self );
+	  arrays[( p + "constituent_m" ).c_str()] = view( c.constituent_m, { nCon }, self );
+	  arrays[( p + "constituent_id" ).c_str()] = view( c.constituent_id, { nCon }, self );
+	}
+	return arrays;
+      } );
+
+  py::class_<BatchSource>( m, "BatchSource" )
+    .def( py::init( []( std::string const & config, long seed, std::string const & jets,
+			double sd_zcut, double sd_beta, std::string const & sd_scan,
+			unsigned int max_n, std::vector<double> const & betas, double lepfrac,
+			bool constituents, bool skip_empty, bool event_seeds,
+			unsigned long first_event, unsigned long n_events, std::string const & init_cache ) {
+	    BatchOptions opt;
+	    opt.configfile = config;
+	    opt.seed = seed;
+	    opt.jets = jets;
+	    opt.sdZcut = sd_zcut;
+	    opt.sdBeta = sd_beta;
+	    opt.sdScan = sd_scan;
+	    opt.maxN = max_n;
+	    opt.betas = betas;
+	    opt.lepfrac = lepfrac;
+	    opt.constituents = constituents;
+	    opt.skipEmpty = skip_empty;
+	    opt.eventSeeds = event_seeds;
+	    opt.firstEvent = first_event;
+	    opt.nEvents = n_events;
+	    opt.initCacheDir = init_cache;
+	    py::gil_scoped_release release;
+	    return new BatchSource( opt );
+	  } ),
+      py::arg( "config" ), py::arg( "seed" ) = -1, py::arg( "jets" ) = "jet:antikt:0.8:170",
+      py::arg( "sd_zcut" ) = 0.10, py::arg( "sd_beta" ) = 0.0, py::arg( "sd_scan" ) = "",
+      py::arg( "max_n" ) = 4, py::arg( "betas" ) = std::vector<double>{ 1.0 }, py::arg( "lepfrac" ) = 0.9,
+      py::arg( "constituents" ) = true, py::arg( "skip_empty" ) = true, py::arg( "event_seeds" ) = false,
+      py::arg( "first_event" ) = 0, py::arg( "n_events" ) = 0, py::arg( "init_cache" ) = "" )
+    // Up to n events; fewer (possibly none) once n_events have been generated.
+    .def( "next_batch", []( BatchSource & source, size_t n ) {
+	auto batch = std::make_shared<EventBatch>();
+	py::gil_scoped_release release;
+	source.fill( *batch, n );
+	return batch;
+      }, py::arg( "n" ) )
+    .def_property_readonly( "events_generated", &BatchSource::eventsGenerated )
+    .def( "stat", []( BatchSource & source ) { source.generator().pythia.stat(); } );
+}
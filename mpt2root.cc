@@ -20,6 +20,21 @@
 // ROOT, for saving Pythia events as trees in a file.
 #include "TTree.h"
 #include "TFile.h"
+#include "TROOT.h"
+
+#include "EventRecord.h"
+#include "RunStats.h"
+#include "JetCollections.h"
+#include "BatchKinematics.h"
+#include "JetSubstructure.h"
+#include "SoftDropScanOutput.h"
+#include "Generator.h"
+#include "ParticleSelector.h"
+#include "Pipeline.h"
+#include "CommonOptions.h"
+
+#include <ctime>
+#include <unistd.h>
 
 using namespace Pythia8;
 
@@ -37,252 +52,295 @@ protected :
   unsigned int i_; 
 };
 
+// Kinematics and groomed mass of one jet collection, and the groomed mass
+// at each of nScan SoftDrop scan points.
+struct KinematicJets : public Collection {
+  KinematicJets( JetSpec const & spec, size_t nScan = 0 ) :
+    Collection( spec.counter(), 16 ),
+    pt  ( add<Float_t>( spec.prefix + "_pt" ) ),
+    eta ( add<Float_t>( spec.prefix + "_eta" ) ),
+    phi ( add<Float_t>( spec.prefix + "_phi" ) ),
+    m   ( add<Float_t>( spec.prefix + "_m" ) ),
+    msd ( add<Float_t>( spec.prefix + "_msd" ) )
+  {
+    if ( nScan > 0 ) sdscan_msd = &addRows<Float_t>( spec.prefix + "_sdscan_msd", nScan );
+  }
+
+  Column<Float_t> & pt;
+  Column<Float_t> & eta;
+  Column<Float_t> & phi;
+  Column<Float_t> & m;
+  Column<Float_t> & msd;
+  RowColumn<Float_t> * sdscan_msd = nullptr;
+};
+
+// Everything mpt2root writes for one event, and the particles to cluster.
+struct MptEvent {
+  MptEvent( std::vector<JetSpec> const & specs, size_t nScan ) {
+    for ( auto const & spec : specs ) jetCollections.emplace_back( new KinematicJets( spec, nScan ) );
+  }
+  MptEvent( MptEvent const & ) = delete;
+  MptEvent & operator=( MptEvent const & ) = delete;
+
+  ULong64_t eventNum = 0;                         // need to store an event number for uproot access
+  Float_t mpt_pt = 0.;
+  Float_t mpt_phi = 0.;
+  Float_t mpt_ptsd = 0.;
+  Float_t mpt_phisd = 0.;
+  std::vector<std::unique_ptr<KinematicJets> > jetCollections;
+  ParticleColumns gen{ "gen", "nGen" };
+  // Not written: the state of the event between the stages.
+  bool generated = false;
+  bool truncated = false;
+  std::vector<fastjet::PseudoJet> particles;
+
+  void book( TTree * T ) {
+    T->Branch("eventNum",    &eventNum,  "eventNum/l");
+    T->Branch("mpt_pt",  &mpt_pt,  "mpt_pt/F");
+    T->Branch("mpt_phi",  &mpt_phi,  "mpt_phi/F");
+    T->Branch("mpt_ptsd",  &mpt_ptsd,  "mpt_ptsd/F");
+    T->Branch("mpt_phisd",  &mpt_phisd,  "mpt_phisd/F");
+    for ( auto & jet : jetCollections ) jet->book( T );
+    gen.book( T );
+  }
+  void clear() {
+    mpt_pt = mpt_phi = mpt_ptsd = mpt_phisd = 0.;
+    for ( auto & jet : jetCollections ) jet->clear();
+    gen.clear();
+    truncated = false;
+  }
+  void sync() {
+    for ( auto & jet : jetCollections ) jet->sync();
+    gen.sync();
+  }
+  void copyFrom( MptEvent const & o ) {
+    eventNum = o.eventNum;
+    mpt_pt = o.mpt_pt;
+    mpt_phi = o.mpt_phi;
+    mpt_ptsd = o.mpt_ptsd;
+    mpt_phisd = o.mpt_phisd;
+    for ( size_t i = 0; i < jetCollections.size(); ++i ) jetCollections[i]->copyFrom( *o.jetCollections[i] );
+    gen.copyFrom( o.gen );
+  }
+};
+
+// Stages of the event loop timed by RunStats.
+enum Stage { kNext, kParticles, kCluster, kMpt, kSoftDrop, kFill };
+const std::vector<std::string> stageNames = { "next", "particles", "cluster", "mpt", "softdrop", "fill" };
+
 int main(int argc, char ** argv) {
 
-  if ( argc < 4 ) {
-    std::cout << "usage: " << argv[0] << " config_file root_file n_events <optional: seed (-1 = default, 0=use time, or input your own)> " << std::endl;
+  // Strip the "--option value" switches, leaving the positional arguments.
+  CommonOptions opt;
+  std::vector<char *> args;
+  for ( int i = 0; i < argc; ++i ) {
+    bool ok = true;
+    if ( opt.parse( i, argc, argv, ok ) ) {
+      if ( !ok ) return 1;
+    } else {
+      args.push_back( argv[i] );
+    }
+  }
+
+  if ( !opt.positional( args ) ) {
+    std::cout << "usage: " << args[0] << " " << CommonOptions::usage() << " config_file root_file n_events <optional: seed (-1 = default, 0=use time, or input your own)> " << std::endl;
     return 0;
   }
 
 
-  // Define the AK4 jet finder.
+  // Define the AK4 jet finder, unless other collections were asked for.
   double R = 0.4, ptmin = 20.0, lepfrac = 0.9;
   bool exclude_leptons_from_jets = true; 
-  fastjet::JetDefinition jet_def(fastjet::antikt_algorithm, R);
-  fastjet::JetDefinition mpt_def(fastjet::kt_algorithm, 1000);
+  if ( opt.jets.empty() ) opt.jets.push_back( JetSpec{ "jet", fastjet::antikt_algorithm, R, ptmin } );
+  JetClusterer clusterer( opt.jets );
+  const double kMptMin = 1.0;                     // as inclusive_jets(1) of the former kt R = 1000 clustering
 
   bool verbose = false;
 
-  char * configfile = argv[1];
-  char * outfile = argv[2];
-  unsigned int nEvents = atol(argv[3]);
-  long seed = -1; 
-  if ( argc > 5 ) {
-    seed = atol(argv[4]);
-  }
-  
   double z_cut = 0.10;
   double beta  = 0.0;
   fastjet::contrib::SoftDrop sd(beta, z_cut);
+  // The jets are groomed at (z_cut, beta) and the scan points from one C/A reclustering each.
+  // No N-subjettiness here, and the leptons are kept out of the jets by the selector instead of lepfrac.
+  JetSubstructure substructure( GroomingPoint{ z_cut, beta }, opt.sdScan, 0, {}, lepfrac );
+  SoftDropScan const & jetGroomer = substructure.groomer();
 
   // Create Pythia instance. Read config from a text file. 
-  Pythia pythia;
-  char buff[1000];
-  sprintf(buff, "Random:seed = %d", seed);
-  pythia.readString("Random:setSeed = on");
-  pythia.readString(buff);
-  std::ifstream config( configfile );
-  while (!config.eof() ) {
-    std::string line;
-    std::getline( config, line );
-    if ( line[0] != '!' && line != "" && line != "\n" ){
-      pythia.readString(line);
-    }
-  }
-  pythia.init();
+  // Random numbers of each event from the seed and eventNum only, see EventSeeds.h.
+  opt.resolveEventSeed();
+  Generator generator;
+  Pythia & pythia = generator.pythia;
+  generator.configure( opt.configfile, opt.seed );
+  if ( opt.eventSeeds ) generator.useEventSeeds( opt.seed );
+  generator.init( opt.initCacheDir, std::to_string( getpid() ) );
+
+  // The write stage fills the tree on its own thread.
+  if ( opt.pipelineSlots > 0 ) ROOT::EnableThreadSafety();
 
   // Set up the ROOT TFile and TTree.
-  TFile *file = TFile::Open(outfile,"recreate");
-  Event *event = &pythia.event;
+  TFile *file = TFile::Open(opt.outfile.c_str(),"recreate");
   const Int_t kMaxJet = 10;                       // Stores leading 10 jets
-  const Int_t kMaxGen = 5000;                     // and 1000 of the generator particles
-  ULong64_t eventNum = 0;                         // need to store an event number for uproot access
-  Float_t mpt_pt=0.;
-  Float_t mpt_phi=0.;
-  Float_t mpt_eta=0.;
-  Float_t mpt_ptsd=0.;
-  Float_t mpt_phisd=0.;
-
-  Int_t nJet=0;
-  Float_t jet_pt[kMaxJet];
-  Float_t jet_eta[kMaxJet];
-  Float_t jet_phi[kMaxJet];
-  Float_t jet_m[kMaxJet];
-  Float_t jet_msd[kMaxJet];
-
-  Int_t   nGen=0;
-  Int_t   gen_orig[kMaxGen]; // original index for debugging
-  Float_t gen_pt[kMaxGen];
-  Float_t gen_eta[kMaxGen];
-  Float_t gen_phi[kMaxGen];
-  Float_t gen_m[kMaxGen];
-  Int_t   gen_id[kMaxGen];
-  Int_t   gen_flags[kMaxGen];
-  Int_t   gen_status[kMaxGen];
-  Int_t   gen_mother1[kMaxGen];
-  Int_t   gen_mother2[kMaxGen];
-  Int_t   gen_daughter1[kMaxGen];
-  Int_t   gen_daughter2[kMaxGen];
-  Int_t   gen_col[kMaxGen];
-  Float_t   gen_vxx[kMaxGen];
-  Float_t   gen_vyy[kMaxGen];
-  Float_t   gen_vzz[kMaxGen];
-  Float_t   gen_tau[kMaxGen];
+
+  // Output columns; they grow as needed and keep their capacity between events.
+  // The branches point into booked; with --pipeline each slot has its own copy.
+  MptEvent booked( opt.jets, jetGroomer.nScan() );
+  std::vector<std::unique_ptr<MptEvent> > copies;
+  std::vector<MptEvent *> slots = { &booked };
+  if ( opt.pipelineSlots > 0 ) {
+    slots.clear();
+    for ( unsigned int i = 0; i < opt.pipelineSlots; ++i ) {
+      copies.emplace_back( new MptEvent( opt.jets, jetGroomer.nScan() ) );
+      slots.push_back( copies.back().get() );
+    }
+  }
+  // Final-state particles, |eta| < 5 and, optionally, not from a Z or W.
+  ParticleSelector selector( 5.0 );
 
   TTree * T = new TTree("T","ev1 Tree");         // Allocate the tree, but DO NOT DELETE IT since ROOT takes ownership magically.
-  T->Branch("eventNum",    &eventNum,  "eventNum/l");
-  T->Branch("mpt_pt",  &mpt_pt,  "mpt_pt/F");
-  T->Branch("mpt_phi",  &mpt_phi,  "mpt_phi/F");
-  T->Branch("mpt_ptsd",  &mpt_ptsd,  "mpt_ptsd/F");
-  T->Branch("mpt_phisd",  &mpt_phisd,  "mpt_phisd/F");
-  T->Branch("nJet",    &nJet,  "nJet/I");
-  T->Branch("jet_pt",  &jet_pt,  "jet_pt[nJet]/F");
-  T->Branch("jet_eta", &jet_eta, "jet_eta[nJet]/F");
-  T->Branch("jet_phi", &jet_phi, "jet_phi[nJet]/F");
-  T->Branch("jet_m",   &jet_m,   "jet_m[nJet]/F");
-  T->Branch("jet_msd",   &jet_msd,   "jet_msd[nJet]/F");
-  T->Branch("nGen",    &nGen,  "nGen/I");
-  T->Branch("gen_pt",        &gen_pt,  "gen_pt[nGen]/F");
-  T->Branch("gen_eta",       &gen_eta, "gen_eta[nGen]/F");
-  T->Branch("gen_phi",       &gen_phi, "gen_phi[nGen]/F");
-  T->Branch("gen_m",         &gen_m,   "gen_m[nGen]/F");
-  T->Branch("gen_flags",     &gen_flags,     "gen_flags[nGen]/I");
-  T->Branch("gen_id",        &gen_id,        "gen_id[nGen]/I"       );
-  T->Branch("gen_status",    &gen_status,    "gen_status[nGen]/I"   );
-  T->Branch("gen_mother1",   &gen_mother1,   "gen_mother1[nGen]/I"  );
-  T->Branch("gen_mother2",   &gen_mother2,   "gen_mother2[nGen]/I"  );
-  T->Branch("gen_daughter1", &gen_daughter1, "gen_daughter1[nGen]/I");
-  T->Branch("gen_daughter2", &gen_daughter2, "gen_daughter2[nGen]/I");
-  T->Branch("gen_col",       &gen_col,       "gen_col[nGen]/I"      );
-  T->Branch("gen_vxx",       &gen_vxx,       "gen_vxx[nGen]/F"      );
-  T->Branch("gen_vyy",       &gen_vyy,       "gen_vyy[nGen]/F"      );
-  T->Branch("gen_vzz",       &gen_vzz,       "gen_vzz[nGen]/F"      );
-  T->Branch("gen_tau",       &gen_tau,       "gen_tau[nGen]/F"      );
-  
-  
- // Begin event loop. Generate event; skip if generation aborted.
-  for (int iEvent = 0; iEvent < nEvents; ++iEvent) {
-    eventNum = iEvent; 
-    nGen = nJet = 0;
-    if (!pythia.next()) continue;
+  booked.book( T );
+
+  // Each stage charges its own RunStats; the write stage also counts the events.
+  std::vector<RunStats> stats( 3, RunStats( stageNames, opt.reportEvery ) );
+  stats[0].initSeconds = generator.initSeconds();
+  stats[0].initSavedSeconds = generator.initSavedSeconds();
+  auto wallStart = RunStats::Clock::now();
+
+  // Generate the event and select the particles to cluster.
+  unsigned int iEvent = 0;
+  auto generateStage = [&]( MptEvent & ev ) {
+    if ( iEvent >= opt.nEvents ) return false;
+    RunStats & st = stats[0];
+    st.skip();
+    ev.eventNum = opt.firstEvent + iEvent++;
+    ev.clear();
+    ev.generated = generator.next( ev.eventNum );
+    st.lap( kNext );
+    if ( !ev.generated ) return true;
     if ( verbose ) 
-      std::cout << "Generating event " << iEvent << std::endl;
-
-    mpt_pt = mpt_phi = mpt_ptsd = mpt_phisd = 0.; 
-    for ( auto x : jet_pt ) x=0.0;
-    for ( auto x : jet_eta ) x=0.0;
-    for ( auto x : jet_phi ) x=0.0;
-    for ( auto x : jet_m ) x=0.0;
-    for ( auto x : jet_msd ) x=0.0;
-
-    for ( auto x : gen_pt ) x=0.0;
-    for ( auto x : gen_eta ) x=0.0;
-    for ( auto x : gen_phi ) x=0.0;
-    for ( auto x : gen_m ) x=0.0;
-    for ( auto x : gen_flags ) x = 0;
-    for ( auto x : gen_id ) x = 0;
-    for ( auto x : gen_status ) x = 0;
-    for ( auto x : gen_mother1 ) x = 0;
-    for ( auto x : gen_mother2 ) x = 0;
-    for ( auto x : gen_daughter1 ) x = 0;
-    for ( auto x : gen_daughter2 ) x = 0;
-    for ( auto x : gen_col ) x = 0;
-    for ( auto x : gen_vxx ) x = 0.;
-    for ( auto x : gen_vyy ) x = 0.;
-    for ( auto x : gen_vzz ) x = 0.;
-    for ( auto x : gen_tau ) x = 0.;
+      std::cout << "Generating event " << ev.eventNum << std::endl;
 
     // Dump the PYTHIA8 content.     
-    // Create AK8 jets with pt > 170 GeV
-    std::vector<fastjet::PseudoJet> fj_particles;
-    std::map<int,int> constituentmap;
-    for (int i = 0; i < event->size(); ++i){
-      auto const & p = pythia.event[i];
-      if ( (p.isFinalPartonLevel() || p.isResonance()) && p.idAbs() != 21  ) {
+    selector.clear();
+    selector.addEvent( pythia.event,
+      [&]( Particle const & p, int i ) {
+	if ( p.idAbs() == 21 ) return;
 	if ( verbose ) {
 	  char buff[1000];
 	  sprintf( buff, "  ndx=%6d, id=%6d, status=%6d, p4=(%6.4f,%6.2f,%6.2f,%6.4f)", i, p.id(), p.status(), p.pT(), p.eta(), p.phi(), p.m() );
 	  std::cout << buff << std::endl; 
 	}
-	gen_pt[nGen] = p.pT();
-	gen_eta[nGen] = p.eta();
-	gen_phi[nGen] = p.phi();
-	gen_m[nGen] = p.m();
-	gen_orig[nGen] = i;
-	gen_id[nGen] =         p.id();
-	gen_flags[nGen] =      p.isHadron() << 3 | p.isFinal() << 2 | p.isFinalPartonLevel() << 1 | p.isVisible() << 0; 
-	gen_status[nGen] =     p.status();    
-	gen_mother1[nGen] =    p.mother1();   
-	gen_mother2[nGen] =    p.mother2();   
-	gen_daughter1[nGen] =  p.daughter1(); 
-	gen_daughter2[nGen] =  p.daughter2(); 
-	gen_col[nGen] =        p.col();       
-	gen_vxx[nGen] =        p.xProd();       
-	gen_vyy[nGen] =        p.yProd();       
-	gen_vzz[nGen] =        p.zProd();       
-	gen_tau[nGen] =        p.tau();
-	++nGen;
-	if ( nGen >= kMaxGen ){
-	  std::cout << "too many particles in event " << iEvent << ", storing first " << kMaxGen << std::endl;
-	  break;
-	}
-      } else if ( p.isFinal() && std::abs(p.eta()) < 5. ) {
-	auto imother = p.mother1();
-	auto mother = pythia.event[imother];
+	ev.gen.push( p, i );
+      },
+      []( Particle const &, int ) {} );
+    // The eta cut uses the batch, so Particle::eta() is not evaluated per particle.
+    selector.select( ev.particles, [&]( int i ) {
+	auto const & mother = pythia.event[ pythia.event[i].mother1() ];
 	if ( verbose && mother.idAbs() == 23 ) {
-	  std::cout << "Daughter of Z boson at index " << p.index() << std::endl;
-	}
-	if ( !exclude_leptons_from_jets || (mother.idAbs() != 23 && mother.idAbs() != 24) ) {
-	  fj_particles.emplace_back( p.px(), p.py(), p.pz(), p.e()  );
-	  fj_particles.back().set_user_index( i );
+	  std::cout << "Daughter of Z boson at index " << i << std::endl;
 	}
-      }
-    }
+	return exclude_leptons_from_jets && (mother.idAbs() == 23 || mother.idAbs() == 24);
+      } );
+    st.lap( kParticles );
+    return true;
+  };
+
+  // Cluster, and groom the jets and the recoil.
+  auto jetStage = [&]( MptEvent & ev ) {
+    if ( !ev.generated ) return true;
+    RunStats & st = stats[1];
+    st.skip();
     if ( verbose) std::cout << "About to cluster" << std::endl;
-    fastjet::ClusterSequence cs(fj_particles, jet_def);
-    std::vector<fastjet::PseudoJet> jets = fastjet::sorted_by_pt(cs.inclusive_jets(ptmin));
-
-    fastjet::ClusterSequence cs_mpt(fj_particles, mpt_def);
-    std::vector<fastjet::PseudoJet> mpts = fastjet::sorted_by_pt(cs_mpt.inclusive_jets(1));
-    if ( verbose ) std::cout << " ------ number of mpts : " << mpts.size() << std::endl;
-    if ( mpts.size() > 0 ) {
-      auto mpt =  mpts[0];
-      auto mpt_sd = sd( mpts[0] );
-      mpt_pt    = mpt.pt();
-      mpt_phi   = mpt.phi();
-      mpt_ptsd  = mpt_sd.pt();
-      mpt_phisd = mpt_sd.phi();
-      if ( verbose ) std::cout << " mpt : pt,phi,ptsd,phisd = " << mpt_pt << ", " << mpt_phi << ", " << mpt_ptsd << ", " << mpt_phisd << std::endl;
+    clusterer.cluster( ev.particles );
+    st.lap( kCluster );
+
+    // The recoil of the whole event. A kt clustering with R = 1000 merges every
+    // particle into a single jet, so this is just their vector sum. SoftDrop
+    // reclusters its input with C/A in any case, so grooming the joined
+    // particles gives the same result without the kt clustering.
+    auto mpt = fastjet::join( ev.particles );
+    if ( verbose ) std::cout << " ------ mpt from " << ev.particles.size() << " particles" << std::endl;
+    if ( ev.particles.size() > 0 && mpt.pt() >= kMptMin ) {
+      auto mpt_sd = sd( mpt );
+      ev.mpt_pt    = mpt.pt();
+      ev.mpt_phi   = mpt.phi();
+      ev.mpt_ptsd  = mpt_sd.pt();
+      ev.mpt_phisd = mpt_sd.phi();
+      if ( verbose ) std::cout << " mpt : pt,phi,ptsd,phisd = " << ev.mpt_pt << ", " << ev.mpt_phi << ", " << ev.mpt_ptsd << ", " << ev.mpt_phisd << std::endl;
     }
+    st.lap( kMpt );
 
     if ( verbose ) std::cout << "About to loop over jets" << std::endl;
-    nJet = 0;
-    if ( jets.size() > 0 ) {
+    for ( size_t icoll = 0; icoll < clusterer.size(); ++icoll ) {
+      KinematicJets & jet = *ev.jetCollections[icoll];
+      auto const & jets = clusterer.jets( icoll );
       auto ibegin = jets.begin();
       auto iend = jets.end();
       for ( auto ijet=ibegin;ijet!=iend;++ijet ) {
 	if ( verbose ) std::cout << "processing jet " << ijet - ibegin << std::endl;
 
-	auto sd_jet =  sd(*ijet);
-	if ( nJet < kMaxJet ) { 
-	  
-	  jet_pt[nJet]=ijet->perp();
-	  jet_eta[nJet]=ijet->eta();
-	  jet_phi[nJet]=ijet->phi();
-	  jet_m[nJet]=ijet->m();	  
-	  jet_msd[nJet] = sd_jet.m();
-	  ++nJet;
+	if ( jet.size() < kMaxJet ) { 
+	  substructure.groom( *ijet );
+	  Int_t nJet = jet.push();
+	  jet.pt[nJet]=ijet->perp();
+	  jet.eta[nJet]=ijet->eta();
+	  jet.phi[nJet]=ijet->phi();
+	  jet.m[nJet]=ijet->m();	  
+	  jet.msd[nJet] = jetGroomer.main().m();
+	  for ( size_t ip = 0; ip < jetGroomer.nScan(); ++ip ) (*jet.sdscan_msd)[nJet][ip] = jetGroomer.scanned( ip ).m();
+	} else {
+	  ev.truncated = true;
 	}
       }
-    } // end check if jets.size() > 0
-    if ( verbose ) 
-      std::cout << "About to write" << std::endl;
-    // Fill the pythia event into the TTree.
-    T->Fill();
-    
-    if ( verbose ) 
-      std::cout << "Done writing." << std::endl;
-    
-    // End event loop.
-  }
+    } // end loop over jet collections
+    st.lap( kSoftDrop );
+    return true;
+  };
+
+  // Fill the tree, in event order, and keep count.
+  auto writeStage = [&]( MptEvent & ev ) {
+    RunStats & st = stats[2];
+    st.skip();
+    if ( !ev.generated ) {
+      ++st.aborted;
+    } else {
+      ++st.generated;
+      if ( verbose ) 
+	std::cout << "About to write" << std::endl;
+      // Fill the pythia event into the TTree.
+      if ( &ev != &booked ) booked.copyFrom( ev );
+      booked.sync();
+      T->Fill();
+      st.lap( kFill );
+      ++st.accepted;
+      if ( ev.truncated ) ++st.truncated;
+      if ( verbose ) 
+	std::cout << "Done writing." << std::endl;
+    }
+    if ( st.progressDue() ) st.printProgress( std::cout, "" );
+    return true;
+  };
+
+  // Begin event loop.
+  Pipeline<MptEvent> pipeline( { "generate", "jets", "write" }, { generateStage, jetStage, writeStage }, slots, opt.pipelineSlots > 0 );
+  for ( auto & st : stats ) st.start();
+  pipeline.run();
 
   // Statistics on event generation.
   pythia.stat();
+  generator.print( std::cout );
+  pipeline.print( std::cout );
 
   //  Write tree.
   T->Write();
+  if ( !opt.sdScan.empty() ) SoftDropScanOutput::write( file, opt.sdScan );
   file->Close();
   // DO NOT delete T. 
+  stats[2].lap( kFill );
+  double wallSeconds = std::chrono::duration<double>( RunStats::Clock::now() - wallStart ).count();
+  stats[2].merge( stats[0] );
+  stats[2].merge( stats[1] );
+  stats[2].print( std::cout );
+  stats[2].writeJson( opt.statsFile, "mpt2root", opt.configfile, 1, wallSeconds );
 
   // Done.
   return 0;
@@ -15,548 +15,833 @@
 #include "fastjet/contrib/Nsubjettiness.hh" // In external code, this should be fastjet/contrib/Nsubjettiness.hh
 #include "fastjet/contrib/Njettiness.hh"
 #include "fastjet/contrib/NjettinessPlugin.hh"
-
+#include "JetSubstructure.h"
+#include "PartonLevelVeto.h"
+#include "EventRecord.h"
+#include "RNTupleOutput.h"
+#include "ArrowOutput.h"
+#include "BranchTuning.h"
+#include "JetTensors.h"
+#include "AsyncWriter.h"
+#include "RunStats.h"
+#include "ParticleCache.h"
+#include "JetCollections.h"
+#include "BatchKinematics.h"
+#include "EventWeights.h"
+#include "Checkpoint.h"
+#include "SoftDropScanOutput.h"
+#include "Generator.h"
+#include "ParticleSelector.h"
+#include "Pipeline.h"
+#include "CommonOptions.h"
+#include "EventRing.h"
+
+
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
 
 // ROOT, for saving Pythia events as trees in a file.
 #include "TTree.h"
 #include "TFile.h"
+#include "TROOT.h"
+#include "ROOT/TBufferMerger.hxx"
 
 using namespace Pythia8;
 
-class CompareIndex {
-public:
-  CompareIndex( fastjet::PseudoJet j ) : i_(j.user_index()){
-  }
-  CompareIndex( unsigned int j = 0 ) : i_(j){
-  }
+// Settings shared by all generator workers, on top of the options mpt2root also has.
+// The default jet collection is one AK R collection "jet" above ptmin.
+struct RunConfig : public CommonOptions {
+  double R = 0.8, ptmin = 30.0, lepfrac = 0.9;
+  double sdZcut = 0.10, sdBeta = 0.0;
+  unsigned int nThreads = 1;
+  double vetoMargin = -1.;             // < 0 : no parton-level veto
+  unsigned long vetoAuditEvery = 0;    // let every n-th would-be veto through to check the margin
+  std::vector<std::string> schemaCommands;   // from --drop, applied after the config file
+  double skimPtmin = -1.;              // >= 0 : write only the constituents of stored jets, above this pt
+  JetTensorOptions tensors;            // jet images and particle clouds, if any
+  std::string format = "tree";         // tree, rntuple, parquet or arrow
+  ArrowOutputOptions arrow;            // row groups and encoding of parquet and arrow
+  unsigned int writerSlots = 0;        // > 0 : fill the output on a separate thread with this many records
+  unsigned int imtThreads = 0;         // > 0 : ROOT implicit multithreading for basket compression
+  BranchTuning tuning;                 // compression, basket size and precision of the branch groups
+  std::string cacheOut;                // write the clustered particles to this ParticleCache
+  std::string cacheIn;                 // recluster the particles from this ParticleCache instead of running Pythia
+  std::string shmName;                 // also publish the events to this shared-memory EventRing
+  unsigned long shmSlots = 256;
+  unsigned long shmSlotBytes = 1 << 20;
+  std::string shmPolicy = "block";
+  double unweight = 0.;                // > 0 : unweight to this target weight
+  unsigned long checkpointEvery = 0;   // > 0 : checkpoint every this many events
+  bool resume = false;                 // continue from outfile.checkpoint
+  bool verbose = false;
+};
 
-  bool operator() ( fastjet::PseudoJet const & j ) const { return j.user_index() == i_; }
-  bool operator() ( unsigned int j ) const { return j == i_; }
+// Each worker needs its own random stream. The user seed is offset by the worker
+// index; the Pythia default (-1) and time-based (0) seeds are first turned into an
+// explicit base so that the workers do not all start from the same state.
+// Pythia accepts seeds in [1, 900000000].
+long workerSeed( long seed, unsigned int iworker, unsigned int nworkers ) {
+  if ( nworkers <= 1 ) return seed;
+  long base = seed;
+  if ( seed < 0 ) base = 19780503;                // Pythia's default Random:seed
+  else if ( seed == 0 ) base = std::time(nullptr);
+  return 1 + ( base - 1 + iworker ) % 900000000;
+}
 
-protected : 
-  unsigned int i_; 
+// Stages of the event loop timed by RunStats.
+enum Stage { kNext, kParticles, kCluster, kSoftDrop, kJets, kNsubjettiness, kConstituents, kTensors, kFill };
+const std::vector<std::string> stageNames = { "next", "particles", "cluster", "softdrop", "jets", "nsubjettiness", "constituents", "tensors", "fill" };
+
+// Outputs and inputs shared by all workers; null when not used.
+struct SharedIO {
+  GenJetsNTupleFile * ntuple = nullptr;       // RNTuple output instead of the tree
+  GenJetsArrowFile * arrow = nullptr;         // Parquet or Arrow output instead of the tree
+  ParticleCacheWriter * cacheOut = nullptr;
+  ParticleCacheReader const * cacheIn = nullptr;
+  Checkpoint const * resume = nullptr;        // continue this run instead of starting a new one
+  EventRingWriter * ring = nullptr;           // also publish the written events to shared memory
 };
 
-int main(int argc, char ** argv) {
+// One event on its way through the stages of runWorker.
+struct EventSlot {
+  GenJetsEvent * rec = nullptr;         // the output record being filled
+  unsigned int iEvent = 0;
+  bool generated = false;               // pythia.next() succeeded (always, from a cache)
+  bool kept = false;                    // and the event passed the unweighting
+  bool audited = false;                 // a would-be veto that the parton-level veto let through
+  bool stored = false;                  // some collection has a jet above its ptmin
+  bool truncated = false;               // jets beyond the leading kMaxJet were not stored
+  std::vector<fastjet::PseudoJet> particles;
+  // Position in constituent_* and PDG id of each Pythia event index, rebuilt during every particle loop.
+  std::vector<Int_t> constituentIndex;
+  std::vector<Int_t> particleId;
+};
 
-  if ( argc < 4 ) {
-    std::cout << "usage: " << argv[0] << " config_file root_file n_events <optional: seed (-1 = default, 0=use time, or input your own)> <optional: ptcut>" << std::endl;
-    return 0;
+// Generate events iworker, iworker + nThreads, ... into the tree "T" in file.
+// With merged = true the file is a TBufferMergerFile that is written out
+// periodically, otherwise it is a plain TFile owned by the caller.
+// If io.ntuple or io.arrow is given, the events go to that RNTuple, Parquet or
+// Arrow file instead and file is unused.
+// If io.cacheIn is given, the events are read from it and Pythia is not initialized.
+// The event loop is a Pipeline of three stages: generate (Pythia or the cache,
+// and the particle selection), jets (clustering, grooming, substructure) and
+// write; with --pipeline they run on three threads.
+// The worker's cross section and weight bookkeeping is returned in weights.
+// Returns false if the run could not be resumed.
+bool runWorker( RunConfig const & cfg, unsigned int iworker, TFile * file, bool merged, SharedIO const & io,
+		RunStats & stats, WeightSummary & weights, std::mutex & stdoutMutex ) {
+
+  // Define the jet finders.
+  double lepfrac = cfg.lepfrac;
+  JetClusterer clusterer( cfg.jets );
+
+  // The parton-level veto must keep every event that any collection could store,
+  // so its proxy jets use the largest R and the lowest ptmin of all collections.
+  double ptmin = cfg.jets[0].ptmin, vetoR = 0.;
+  for ( auto const & spec : cfg.jets ) {
+    ptmin = std::min( ptmin, spec.ptmin );
+    vetoR = std::max( vetoR, spec.R );
   }
+  fastjet::JetDefinition jet_def(fastjet::antikt_algorithm, vetoR);
 
+  bool verbose = cfg.verbose;
+  unsigned int nEvents = cfg.nEvents;
+  long seed = workerSeed( cfg.seed, iworker, cfg.nThreads );
 
-  // Define the AK8 jet finder.
-  double R = 0.8, ptmin = 30.0, lepfrac = 0.9;
-  fastjet::JetDefinition jet_def(fastjet::antikt_algorithm, R);
 
-  bool verbose = false;
+  // Create Pythia instance. Read config from a text file. 
+  Generator generator;
+  Pythia & pythia = generator.pythia;
+  OutputSchema::addSettings( pythia.settings );
+  generator.configure( cfg.configfile, seed, cfg.schemaCommands );
+  OutputSchema schema = OutputSchema::fromSettings( pythia.settings );
+  if ( io.cacheIn ) {
+    // The cache only has the final-state particles.
+    schema.history = false;
+    schema.vertices = false;
+  }
 
-  char * configfile = argv[1];
-  char * outfile = argv[2];
-  unsigned int nEvents = atol(argv[3]);
-  long seed = -1; 
-  if ( argc > 5 ) {
-    seed = atol(argv[4]);
+  // Optionally veto, before hadronization, events that cannot pass the leading-jet cut.
+  std::shared_ptr<PartonLevelVeto> partonVeto;
+  if ( cfg.vetoMargin >= 0 && !io.cacheIn ) {
+    partonVeto = std::make_shared<PartonLevelVeto>( jet_def, ptmin, cfg.vetoMargin, cfg.vetoAuditEvery );
+    pythia.setUserHooksPtr( partonVeto );
   }
-  if ( argc > 6 ) {
-    ptmin = atof( argv[5]);
+  // Per-event random streams; cfg.seed is then the same for all workers.
+  if ( cfg.eventSeeds ) generator.useEventSeeds( cfg.seed );
+  if ( !io.cacheIn ) {
+    generator.init( cfg.initCacheDir, std::to_string( getpid() ) + "." + std::to_string( iworker ) );
+    stats.initSeconds = generator.initSeconds();
+    stats.initSavedSeconds = generator.initSavedSeconds();
   }
-
-
-  double z_cut = 0.10;
-  double beta  = 0.0;
-  fastjet::contrib::SoftDrop sd(beta, z_cut);
-
-  // Create Pythia instance. Read config from a text file. 
-  Pythia pythia;
-  char buff[1000];
-  sprintf(buff, "Random:seed = %d", seed);
-  pythia.readString("Random:setSeed = on");
-  pythia.readString(buff);
-  std::ifstream config( configfile );
-  while (!config.eof() ) {
-    std::string line;
-    std::getline( config, line );
-    if ( line[0] != '!' && line != "" && line != "\n" ){
-      pythia.readString(line);
-    }
+  // Pythia is not initialized in recluster-only mode, but unweighting still needs its random numbers.
+  else pythia.rndm.init( seed > 0 ? seed : 19780503 );
+  // The random state of the checkpoint replaces whatever init() left behind.
+  if ( io.resume && !pythia.rndm.readState( io.resume->rndmFile ) ) {
+    std::cout << "Cannot read the random state " << io.resume->rndmFile << std::endl;
+    return false;
   }
-  pythia.init();
+  Unweighter unweighter( cfg.unweight );
+  if ( io.cacheIn ) nEvents = nEvents == 0 ? io.cacheIn->size() : std::min<uint64_t>( nEvents, io.cacheIn->size() );
 
-  // Set up the ROOT TFile and TTree.
-  TFile *file = TFile::Open(outfile,"recreate");
   Event *event = &pythia.event;
   const Int_t kMaxJet = 10;                       // Stores leading 10 jets
-  const Int_t kMaxGen = 5000;                     // and 1000 of the generator particles
-  const Int_t kMaxConstituent = 5000;             // and 1000 of the jet constituents
-  const Int_t kMaxNsjBeta = 4;                    // Various tau beta values
-  ULong64_t eventNum = 0;                         // need to store an event number for uproot access
-  Int_t nJet=0;
-  Float_t jet_pt[kMaxJet];
-  Float_t jet_eta[kMaxJet];
-  Float_t jet_phi[kMaxJet];
-  Float_t jet_m[kMaxJet];
-  Float_t jet_msd[kMaxJet];
-  Float_t jet_tau1   [kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau2   [kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau3   [kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau4   [kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau5   [kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau6   [kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau7   [kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau8   [kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau1_sd[kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau2_sd[kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau3_sd[kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau4_sd[kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau5_sd[kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau6_sd[kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau7_sd[kMaxJet][kMaxNsjBeta];
-  Float_t jet_tau8_sd[kMaxJet][kMaxNsjBeta];
-
-
-  
-  Int_t   jet_nc[kMaxJet];
-  Int_t   jet_ic[kMaxJet][50];
-  Int_t   jet_nsubjet[kMaxJet];
-  Float_t jet_subjet0_pt[kMaxJet];
-  Float_t jet_subjet0_eta[kMaxJet];
-  Float_t jet_subjet0_phi[kMaxJet];
-  Float_t jet_subjet0_m[kMaxJet];
-  Float_t jet_subjet1_pt[kMaxJet];
-  Float_t jet_subjet1_eta[kMaxJet];
-  Float_t jet_subjet1_phi[kMaxJet];
-  Float_t jet_subjet1_m[kMaxJet];
-  Int_t nGen=0;
-  Int_t   gen_orig[kMaxGen]; // original index for debugging
-  Float_t gen_pt[kMaxGen];
-  Float_t gen_eta[kMaxGen];
-  Float_t gen_phi[kMaxGen];
-  Float_t gen_m[kMaxGen];
-  Int_t   gen_id[kMaxGen];
-  Int_t   gen_flags[kMaxGen];
-  Int_t   gen_status[kMaxGen];
-  Int_t   gen_mother1[kMaxGen];
-  Int_t   gen_mother2[kMaxGen];
-  Int_t   gen_daughter1[kMaxGen];
-  Int_t   gen_daughter2[kMaxGen];
-  Int_t   gen_col[kMaxGen];
-  Float_t   gen_vxx[kMaxGen];
-  Float_t   gen_vyy[kMaxGen];
-  Float_t   gen_vzz[kMaxGen];
-  Float_t   gen_tau[kMaxGen];
-
-
-  Int_t nConstituent=0;
-  Int_t   constituent_orig[kMaxConstituent]; // original index for debugging
-  Float_t constituent_pt[kMaxConstituent];
-  Float_t constituent_eta[kMaxConstituent];
-  Float_t constituent_phi[kMaxConstituent];
-  Float_t constituent_m[kMaxConstituent];
-  Int_t   constituent_jetndx[kMaxConstituent];
-  Int_t   constituent_subjetndx[kMaxConstituent];
-  Int_t   constituent_id[kMaxConstituent];
-  Int_t   constituent_flags[kMaxConstituent];
-  Int_t   constituent_status[kMaxConstituent];
-  Int_t   constituent_mother1[kMaxConstituent];
-  Int_t   constituent_mother2[kMaxConstituent];
-  Int_t   constituent_daughter1[kMaxConstituent];
-  Int_t   constituent_daughter2[kMaxConstituent];
-  Int_t   constituent_col[kMaxConstituent];
-  Float_t   constituent_vxx[kMaxConstituent];
-  Float_t   constituent_vyy[kMaxConstituent];
-  Float_t   constituent_vzz[kMaxConstituent];
-  Float_t   constituent_tau[kMaxConstituent];
-
-  TTree * T = new TTree("T","ev1 Tree");         // Allocate the tree, but DO NOT DELETE IT since ROOT takes ownership magically.
-  T->Branch("eventNum",    &eventNum,  "eventNum/l");
-  T->Branch("nJet",    &nJet,  "nJet/I");
-  T->Branch("jet_pt",  &jet_pt,  "jet_pt[nJet]/F");
-  T->Branch("jet_eta", &jet_eta, "jet_eta[nJet]/F");
-  T->Branch("jet_phi", &jet_phi, "jet_phi[nJet]/F");
-  T->Branch("jet_m",   &jet_m,   "jet_m[nJet]/F");
-  T->Branch("jet_msd",   &jet_msd,   "jet_msd[nJet]/F");
-  T->Branch("jet_tau1",   &jet_tau1,   "jet_tau1[nJet][4]/F");
-  T->Branch("jet_tau2",   &jet_tau2,   "jet_tau2[nJet][4]/F");
-  T->Branch("jet_tau3",   &jet_tau3,   "jet_tau3[nJet][4]/F");
-  T->Branch("jet_tau4",   &jet_tau4,   "jet_tau4[nJet][4]/F");
-  T->Branch("jet_tau5",   &jet_tau5,   "jet_tau5[nJet][4]/F");
-  T->Branch("jet_tau6",   &jet_tau6,   "jet_tau6[nJet][4]/F");
-  T->Branch("jet_tau7",   &jet_tau7,   "jet_tau7[nJet][4]/F");
-  T->Branch("jet_tau8",   &jet_tau8,   "jet_tau8[nJet][4]/F");
-  T->Branch("jet_tau1_sd",   &jet_tau1_sd,   "jet_tau1_sd[nJet][4]/F");
-  T->Branch("jet_tau2_sd",   &jet_tau2_sd,   "jet_tau2_sd[nJet][4]/F");
-  T->Branch("jet_tau3_sd",   &jet_tau3_sd,   "jet_tau3_sd[nJet][4]/F");
-  T->Branch("jet_tau4_sd",   &jet_tau4_sd,   "jet_tau4_sd[nJet][4]/F");
-  T->Branch("jet_tau5_sd",   &jet_tau5_sd,   "jet_tau5_sd[nJet][4]/F");
-  T->Branch("jet_tau6_sd",   &jet_tau6_sd,   "jet_tau6_sd[nJet][4]/F");
-  T->Branch("jet_tau7_sd",   &jet_tau7_sd,   "jet_tau7_sd[nJet][4]/F");
-  T->Branch("jet_tau8_sd",   &jet_tau8_sd,   "jet_tau8_sd[nJet][4]/F");
-  T->Branch("jet_nc",  &jet_nc,  "jet_nc[nJet]/I");
-  T->Branch("jet_ic",  &jet_ic,  "jet_ic[nJet][50]/I");
-  T->Branch("jet_nsubjet",  &jet_nsubjet,  "jet_nsubjet[nJet]/I");
-  T->Branch("jet_subjet0_pt",  &jet_subjet0_pt,  "jet_subjet0_pt[nJet]/F");
-  T->Branch("jet_subjet0_eta", &jet_subjet0_eta, "jet_subjet0_eta[nJet]/F");
-  T->Branch("jet_subjet0_phi", &jet_subjet0_phi, "jet_subjet0_phi[nJet]/F");
-  T->Branch("jet_subjet0_m",   &jet_subjet0_m,   "jet_subjet0_m[nJet]/F");
-  T->Branch("jet_subjet1_pt",  &jet_subjet1_pt,  "jet_subjet1_pt[nJet]/F");
-  T->Branch("jet_subjet1_eta", &jet_subjet1_eta, "jet_subjet1_eta[nJet]/F");
-  T->Branch("jet_subjet1_phi", &jet_subjet1_phi, "jet_subjet1_phi[nJet]/F");
-  T->Branch("jet_subjet1_m",   &jet_subjet1_m,   "jet_subjet1_m[nJet]/F");    
-  T->Branch("nGen",    &nGen,  "nGen/I");
-  T->Branch("gen_pt",        &gen_pt,  "gen_pt[nGen]/F");
-  T->Branch("gen_eta",       &gen_eta, "gen_eta[nGen]/F");
-  T->Branch("gen_phi",       &gen_phi, "gen_phi[nGen]/F");
-  T->Branch("gen_m",         &gen_m,   "gen_m[nGen]/F");
-  T->Branch("gen_flags",     &gen_flags,     "gen_flags[nGen]/I");
-  T->Branch("gen_id",        &gen_id,        "gen_id[nGen]/I"       );
-  T->Branch("gen_status",    &gen_status,    "gen_status[nGen]/I"   );
-  T->Branch("gen_mother1",   &gen_mother1,   "gen_mother1[nGen]/I"  );
-  T->Branch("gen_mother2",   &gen_mother2,   "gen_mother2[nGen]/I"  );
-  T->Branch("gen_daughter1", &gen_daughter1, "gen_daughter1[nGen]/I");
-  T->Branch("gen_daughter2", &gen_daughter2, "gen_daughter2[nGen]/I");
-  T->Branch("gen_col",       &gen_col,       "gen_col[nGen]/I"      );
-  T->Branch("gen_vxx",       &gen_vxx,       "gen_vxx[nGen]/F"      );
-  T->Branch("gen_vyy",       &gen_vyy,       "gen_vyy[nGen]/F"      );
-  T->Branch("gen_vzz",       &gen_vzz,       "gen_vzz[nGen]/F"      );
-  T->Branch("gen_tau",       &gen_tau,       "gen_tau[nGen]/F"      );
-
-
-  T->Branch("nConstituent",    &nConstituent,  "nConstituent/I");
-  T->Branch("constituent_pt",        &constituent_pt,  "constituent_pt[nConstituent]/F");
-  T->Branch("constituent_eta",       &constituent_eta, "constituent_eta[nConstituent]/F");
-  T->Branch("constituent_phi",       &constituent_phi, "constituent_phi[nConstituent]/F");
-  T->Branch("constituent_m",         &constituent_m,   "constituent_m[nConstituent]/F");
-  T->Branch("constituent_flags",     &constituent_flags,     "constituent_flags[nConstituent]/I");
-  T->Branch("constituent_id",        &constituent_id,        "constituent_id[nConstituent]/I"       );
-  T->Branch("constituent_jetndx",    &constituent_jetndx,    "constituent_jetndx[nConstituent]/I"   );
-  T->Branch("constituent_subjetndx", &constituent_subjetndx, "constituent_subjetndx[nConstituent]/I");
-  T->Branch("constituent_status",    &constituent_status,    "constituent_status[nConstituent]/I"   );
-  T->Branch("constituent_mother1",   &constituent_mother1,   "constituent_mother1[nConstituent]/I"  );
-  T->Branch("constituent_mother2",   &constituent_mother2,   "constituent_mother2[nConstituent]/I"  );
-  T->Branch("constituent_daughter1", &constituent_daughter1, "constituent_daughter1[nConstituent]/I");
-  T->Branch("constituent_daughter2", &constituent_daughter2, "constituent_daughter2[nConstituent]/I");
-  T->Branch("constituent_col",       &constituent_col,       "constituent_col[nConstituent]/I"      );
-  T->Branch("constituent_vxx",       &constituent_vxx,       "constituent_vxx[nConstituent]/F"      );
-  T->Branch("constituent_vyy",       &constituent_vyy,       "constituent_vyy[nConstituent]/F"      );
-  T->Branch("constituent_vzz",       &constituent_vzz,       "constituent_vzz[nConstituent]/F"      );
-  T->Branch("constituent_tau",       &constituent_tau,       "constituent_tau[nConstituent]/F"      );
-
-  
-  
- // Begin event loop. Generate event; skip if generation aborted.
-  for (int iEvent = 0; iEvent < nEvents; ++iEvent) {
-    eventNum = iEvent; 
-    nConstituent = nGen = nJet = 0;
-    if (!pythia.next()) continue;
+  const Int_t kMaxNsjBeta = JetColumns::kNsjBeta; // Various tau beta values
+  const Long64_t kMergeEvery = 1000;              // Entries between writes to the TBufferMerger
+
+  // N-subjettiness tau_1 ... tau_8 for beta_nsj = 0.5, 1.0, 1.5, 2.0
+  std::vector<double> beta_nsj;
+  for ( unsigned int nsj_index = 0; nsj_index < kMaxNsjBeta; ++nsj_index) beta_nsj.push_back( 0.5 + 0.5*nsj_index );
+  // The main SoftDrop point and the scan points share one C/A reclustering per jet.
+  JetSubstructure substructure( GroomingPoint{ cfg.sdZcut, cfg.sdBeta }, cfg.sdScan, JetColumns::kMaxNsj, beta_nsj, lepfrac );
+  SoftDropScan const & sd = substructure.groomer();
+
+  // Output columns; they grow as needed and keep their capacity between events.
+  // The branches point into booked.
+  GenJetsEvent::JetNames jetNames;
+  for ( auto const & spec : cfg.jets ) jetNames.emplace_back( spec.prefix, spec.counter() );
+  GenJetsEvent booked( jetNames, sd.nScan(), cfg.tensors.shape );
+  JetRasterizer rasterizer( cfg.tensors );
+
+  std::vector<CachedParticle> cacheParticles;
+  // The particles to cluster; their pt, eta and phi are computed in one pass.
+  ParticleSelector selector;
+
+  // Set up the ROOT TTree in this worker's file, or this worker's share of the RNTuple.
+  booked.select( schema );
+  if ( io.cacheIn ) booked.gen.setEnabled( false );
+  cfg.tuning.apply( booked );
+  if ( io.ring ) io.ring->setSchema( EventRingWriter::describe( booked ) );
+  TTree * T = nullptr;
+  std::unique_ptr<GenJetsNTupleFile::Filler> ntupleFiller;
+  std::unique_ptr<GenJetsArrowFile::Filler> arrowFiller;
+  if ( io.ntuple ) {
+    ntupleFiller = io.ntuple->filler( booked );
+  } else if ( io.arrow ) {
+    arrowFiller = io.arrow->filler( booked );
+    if ( !arrowFiller ) return false;
+  } else {
+    file->cd();
+    if ( io.resume ) {
+      file->GetObject( "T", T );
+      if ( !T || !booked.attach( T ) ) {
+	std::cout << "The tree in the output file does not match this configuration, cannot resume" << std::endl;
+	return false;
+      }
+    } else {
+      T = new TTree("T","ev1 Tree");         // Allocate the tree, but DO NOT DELETE IT since ROOT takes ownership magically.
+      booked.book( T );
+    }
+    cfg.tuning.apply( booked, T );
+  }
+  // Entries that were saved after the last checkpoint; they are generated again but not filled twice.
+  Long64_t skipFills = io.resume ? T->GetEntries() - io.resume->entries : 0;
+  bool lossy = cfg.tuning.lossy();
+  auto fillOutput = [&]() {
+    if ( lossy ) booked.reducePrecision();
+    if ( ntupleFiller ) {
+      ntupleFiller->fill();
+    } else if ( arrowFiller ) {
+      arrowFiller->fill();
+    } else if ( skipFills > 0 ) {
+      --skipFills;
+      return;
+    } else {
+      booked.sync();
+      T->Fill();
+      // Hand the filled baskets to the merger every so often to bound the memory per worker.
+      if ( merged && T->GetEntries() % kMergeEvery == 0 ) file->Write();
+    }
+    if ( io.ring ) io.ring->publish( booked );
+  };
+
+  // Optionally fill on a writer thread; the event loop then fills records from its pool.
+  std::unique_ptr<AsyncWriter> asyncWriter;
+  if ( cfg.writerSlots > 0 ) asyncWriter.reset( new AsyncWriter( booked, fillOutput, cfg.writerSlots ) );
+
+  // The events in flight. Inline there is one slot, filling booked (or the AsyncWriter's
+  // records); with --pipeline every slot has its own record, copied to booked by the write stage.
+  std::vector<std::unique_ptr<EventSlot> > slotPool;
+  std::vector<std::unique_ptr<GenJetsEvent> > slotRecords;
+  std::vector<EventSlot *> slots;
+  for ( unsigned int i = 0; i < std::max( 1u, cfg.pipelineSlots ); ++i ) {
+    slotPool.emplace_back( new EventSlot );
+    slotPool.back()->rec = &booked;
+    if ( cfg.pipelineSlots > 0 ) {
+      slotRecords.emplace_back( new GenJetsEvent( jetNames, sd.nScan(), cfg.tensors.shape ) );
+      slotRecords.back()->select( booked.schema );
+      slotPool.back()->rec = slotRecords.back().get();
+    }
+    slots.push_back( slotPool.back().get() );
+  }
+
+  // Flush the tree and save the random state and bookkeeping, before generating nextEvent.
+  std::string lastRndm = io.resume ? io.resume->rndmFile : "";
+  auto checkpoint = [&]( unsigned int nextEvent ) {
+    T->AutoSave( "SaveSelf" );
+    Checkpoint cp;
+    cp.config = cfg.configfile;
+    cp.seed = cfg.seed;
+    cp.nextEvent = nextEvent;
+    cp.entries = T->GetEntries();
+    cp.rndmFile = cfg.outfile + ".rndm." + std::to_string( nextEvent );
+    if ( io.resume ) cp.segments = io.resume->segments;
+    cp.segments.push_back( WeightSummary::from( io.cacheIn ? nullptr : &pythia.info, unweighter ) );
+    if ( !pythia.rndm.dumpState( cp.rndmFile ) || !cp.write( Checkpoint::filename( cfg.outfile ) ) ) return;
+    if ( lastRndm != "" ) std::remove( lastRndm.c_str() );
+    lastRndm = cp.rndmFile;
+  };
+
+  // The write stage keeps the event counts in stats; the other two have their
+  // own RunStats, merged into it at the end, so that each thread times itself.
+  std::vector<RunStats> stageStats( 2, RunStats( stageNames ) );
+  std::string label = cfg.nThreads > 1 ? "[worker " + std::to_string(iworker) + "] " : "";
+  unsigned int firstEvent = io.resume ? io.resume->nextEvent : iworker;
+  unsigned int iEvent = firstEvent;
+
+  // Generate the next event, or read it from the cache, and select the particles to cluster.
+  auto generateStage = [&]( EventSlot & slot ) {
+    if ( iEvent >= nEvents ) return false;
+    RunStats & st = stageStats[0];
+    if ( cfg.checkpointEvery > 0 && iEvent > firstEvent && iEvent % cfg.checkpointEvery == 0 ) checkpoint( iEvent );
+    st.skip();
+    slot.iEvent = iEvent;
+    iEvent += cfg.nThreads;
+    if ( asyncWriter ) slot.rec = &asyncWriter->acquire();
+    GenJetsEvent & rec = *slot.rec;
+    ParticleColumns & gen = rec.gen;
+    ConstituentColumns & constituent = rec.constituents;
+    rec.eventNum = io.cacheIn ? io.cacheIn->event( slot.iEvent ).eventNum : cfg.firstEvent + slot.iEvent;
+    rec.clear();
+    st.lap( kFill );                              // waiting for a free record
+    slot.kept = false;
+    slot.generated = io.cacheIn ? true : generator.next( rec.eventNum );
+    slot.audited = partonVeto && partonVeto->takeAudited();
+    st.lap( kNext );
+    if ( !slot.generated ) return true;
     if ( verbose ) 
-      std::cout << "Generating event " << iEvent << std::endl;
-    for ( auto x : jet_pt ) x=0.0;
-    for ( auto x : jet_eta ) x=0.0;
-    for ( auto x : jet_phi ) x=0.0;
-    for ( auto x : jet_m ) x=0.0;
-    for ( auto x : jet_msd ) x=0.0;
-
-
-    for ( auto x : jet_tau1    ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau2    ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau3    ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau4    ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau5    ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau6    ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau7    ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau8    ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau1_sd ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau2_sd ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau3_sd ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau4_sd ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau5_sd ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau6_sd ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau7_sd ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_tau8_sd ) for ( unsigned int j = 0; j < kMaxNsjBeta; ++j )  x[j]=0.0;
-    for ( auto x : jet_nc ) x=0;
-    for ( auto x : jet_nsubjet ) x=0;
-    for ( auto i = 0; i < kMaxJet; ++i )
-      for ( auto j = 0; j < 50; ++j )
-	jet_ic[i][j] = 0;
-    for ( auto x : jet_subjet0_pt ) x=0.0;
-    for ( auto x : jet_subjet0_eta ) x=0.0;
-    for ( auto x : jet_subjet0_phi ) x=0.0;
-    for ( auto x : jet_subjet0_m ) x=0.0;
-    for ( auto x : jet_subjet1_pt ) x=0.0;
-    for ( auto x : jet_subjet1_eta ) x=0.0;
-    for ( auto x : jet_subjet1_phi ) x=0.0;
-    for ( auto x : jet_subjet1_m ) x=0.0;    
-    for ( auto x : gen_pt ) x=0.0;
-    for ( auto x : gen_eta ) x=0.0;
-    for ( auto x : gen_phi ) x=0.0;
-    for ( auto x : gen_m ) x=0.0;
-    for ( auto x : gen_flags ) x = 0;
-    for ( auto x : gen_id ) x = 0;
-    for ( auto x : gen_status ) x = 0;
-    for ( auto x : gen_mother1 ) x = 0;
-    for ( auto x : gen_mother2 ) x = 0;
-    for ( auto x : gen_daughter1 ) x = 0;
-    for ( auto x : gen_daughter2 ) x = 0;
-    for ( auto x : gen_col ) x = 0;
-    for ( auto x : gen_vxx ) x = 0.;
-    for ( auto x : gen_vyy ) x = 0.;
-    for ( auto x : gen_vzz ) x = 0.;
-    for ( auto x : gen_tau ) x = 0.;
-    for ( auto x : constituent_pt ) x=0.0;
-    for ( auto x : constituent_eta ) x=0.0;
-    for ( auto x : constituent_phi ) x=0.0;
-    for ( auto x : constituent_m ) x=0.0;
-    for ( auto x : constituent_flags ) x = 0;
-    for ( auto x : constituent_jetndx ) x = -1;
-    for ( auto x : constituent_subjetndx ) x = -1;
-    for ( auto x : constituent_id ) x = 0;
-    for ( auto x : constituent_status ) x = 0;
-    for ( auto x : constituent_mother1 ) x = 0;
-    for ( auto x : constituent_mother2 ) x = 0;
-    for ( auto x : constituent_daughter1 ) x = 0;
-    for ( auto x : constituent_daughter2 ) x = 0;
-    for ( auto x : constituent_col ) x = 0;
-    for ( auto x : constituent_vxx ) x = 0.;
-    for ( auto x : constituent_vyy ) x = 0.;
-    for ( auto x : constituent_vzz ) x = 0.;
-    for ( auto x : constituent_tau ) x = 0.;
+      std::cout << "Generating event " << slot.iEvent << std::endl;
+
+    // Events rejected by the unweighting go no further.
+    double weight = io.cacheIn ? io.cacheIn->event( slot.iEvent ).weight : pythia.info.weight();
+    rec.weight = unweighter.accept( weight, pythia.rndm );
+    if ( rec.weight == 0. ) return true;
+    slot.kept = true;
 
     // Dump the PYTHIA8 content.     
-    // Create AK8 jets with pt > 170 GeV
-    std::vector<fastjet::PseudoJet> fj_particles;
-    std::map<int,int> constituentmap;
-    for (int i = 0; i < event->size(); ++i){
-      auto const & p = pythia.event[i];
-      if ( p.isFinalPartonLevel() || p.isResonance()) {
-	if ( verbose ) {
-	  char buff[1000];
-	  sprintf( buff, "  ndx=%6d, id=%6d, status=%6d, p4=(%6.4f,%6.2f,%6.2f,%6.4f)", i, p.id(), p.status(), p.pT(), p.eta(), p.phi(), p.m() );
-	  std::cout << buff << std::endl; 
-	}
-	gen_pt[nGen] = p.pT();
-	gen_eta[nGen] = p.eta();
-	gen_phi[nGen] = p.phi();
-	gen_m[nGen] = p.m();
-	gen_orig[nGen] = i;
-	gen_id[nGen] =         p.id();
-	gen_flags[nGen] =      p.isHadron() << 3 | p.isFinal() << 2 | p.isFinalPartonLevel() << 1 | p.isVisible() << 0; 
-	gen_status[nGen] =     p.status();    
-	gen_mother1[nGen] =    p.mother1();   
-	gen_mother2[nGen] =    p.mother2();   
-	gen_daughter1[nGen] =  p.daughter1(); 
-	gen_daughter2[nGen] =  p.daughter2(); 
-	gen_col[nGen] =        p.col();       
-	gen_vxx[nGen] =        p.xProd();       
-	gen_vyy[nGen] =        p.yProd();       
-	gen_vzz[nGen] =        p.zProd();       
-	gen_tau[nGen] =        p.tau();             
-	++nGen;
-	if ( nGen >= kMaxGen ){
-	  std::cout << "too many particles in event " << iEvent << ", storing first " << kMaxGen << std::endl;
-	  break;
-	}
-      } else if ( p.isFinal() ) {
-
-	constituent_pt[nConstituent] = p.pT();
-	constituent_eta[nConstituent] = p.eta();
-	constituent_phi[nConstituent] = p.phi();
-	constituent_m[nConstituent] = p.m();
-	constituent_orig[nConstituent] = i;
-	constituent_jetndx[nConstituent] =     -1; // set later
-	constituent_subjetndx[nConstituent] =  -1; // set later
-	constituent_id[nConstituent] =         p.id();
-	constituent_flags[nConstituent] =      p.isHadron() << 3 | p.isFinal() << 2 | p.isFinalPartonLevel() << 1 | p.isVisible() << 0; 
-	constituent_status[nConstituent] =     p.status();    
-	constituent_mother1[nConstituent] =    p.mother1();   
-	constituent_mother2[nConstituent] =    p.mother2();   
-	constituent_daughter1[nConstituent] =  p.daughter1(); 
-	constituent_daughter2[nConstituent] =  p.daughter2(); 
-	constituent_col[nConstituent] =        p.col();       
-	constituent_vxx[nConstituent] =        p.xProd();       
-	constituent_vyy[nConstituent] =        p.yProd();       
-	constituent_vzz[nConstituent] =        p.zProd();       
-	constituent_tau[nConstituent] =        p.tau();             
-	if ( p.isFinal() ) {
-	  fj_particles.emplace_back( p.px(), p.py(), p.pz(), p.e()  );
-	  fj_particles.back().set_user_index( i );
-	  constituentmap[i] = nConstituent;
-	} 
-	++nConstituent;
-	if ( nConstituent >= kMaxConstituent ){
-	  std::cout << "too many jet constituents in event " << iEvent << ", storing first " << kMaxConstituent << std::endl;
-	  break;
-	}
+    std::vector<Int_t> & constituentIndex = slot.constituentIndex;
+    std::vector<Int_t> & particleId = slot.particleId;
+    selector.clear();
+    if ( io.cacheIn ) {
+      // Recluster-only: the particles that were clustered when the cache was written.
+      auto const & cached = io.cacheIn->event( slot.iEvent );
+      auto particles = io.cacheIn->particles( cached );
+      constituentIndex.resize( cached.eventSize );
+      particleId.resize( cached.eventSize );
+      for ( unsigned int j = 0; j < cached.n; ++j ) {
+	auto const & p = particles[j];
+	selector.add( p.px, p.py, p.pz, p.e, p.index );
+	particleId[p.index] = p.id;
+	if ( schema.constituents ) constituentIndex[p.index] = constituent.push( p, false );
       }
+    } else {
+      constituentIndex.resize( event->size() );
+      particleId.resize( event->size() );
+      cacheParticles.clear();
+      selector.addEvent( pythia.event,
+	[&]( Particle const & p, int i ) {
+	  if ( verbose ) {
+	    char buff[1000];
+	    sprintf( buff, "  ndx=%6d, id=%6d, status=%6d, p4=(%6.4f,%6.2f,%6.2f,%6.4f)", i, p.id(), p.status(), p.pT(), p.eta(), p.phi(), p.m() );
+	    std::cout << buff << std::endl;
+	  }
+	  gen.push( p, i );
+	},
+	[&]( Particle const & p, int i ) {
+	  particleId[i] = p.id();
+	  if ( schema.constituents ) constituentIndex[i] = constituent.push( p, i, false );
+	  if ( io.cacheOut ) cacheParticles.push_back( CachedParticle::from( p, i ) );
+	} );
+      if ( io.cacheOut ) io.cacheOut->write( rec.eventNum, event->size(), rec.weight, cacheParticles );
     }
+    // The constituents were pushed in the same order as the selector's particles, from entry 0.
+    selector.select( slot.particles );
+    if ( schema.constituents ) constituent.setKinematics( selector.batch() );
+    st.lap( kParticles );
+    return true;
+  };
+
+  // Cluster, groom and measure the jets, and tag their constituents.
+  auto jetStage = [&]( EventSlot & slot ) {
+    slot.stored = false;
+    slot.truncated = false;
+    if ( !slot.kept ) return true;
+    RunStats & st = stageStats[1];
+    st.skip();
+    GenJetsEvent & rec = *slot.rec;
+    ConstituentColumns & constituent = rec.constituents;
+    std::vector<Int_t> const & constituentIndex = slot.constituentIndex;
+    std::vector<Int_t> const & particleId = slot.particleId;
     if ( verbose) std::cout << "About to cluster" << std::endl;
-    fastjet::ClusterSequence cs(fj_particles, jet_def);
-    std::vector<fastjet::PseudoJet> jets = fastjet::sorted_by_pt(cs.inclusive_jets(ptmin));
+    clusterer.cluster( slot.particles );
+    st.lap( kCluster );
 
     if ( verbose ) std::cout << "About to loop over jets" << std::endl;
-    nJet = 0;
-    if ( jets.size() > 0 ) {
-      auto ibegin = jets.begin();
-      auto iend = jets.end();
-      for ( auto ijet=ibegin;ijet!=iend;++ijet ) {
-	if ( verbose ) std::cout << "processing jet " << ijet - ibegin << std::endl;
-
-	auto sd_jet =  sd(*ijet);
-	auto constituents = ijet->constituents();
-
-	// Get the fraction of the jet originating from leptons.
-	// This is to remove jets that are comprised entirely of isolated leptons
-	// such as Z->ll.
-	// We ignore jets with >90% of their energy from leptons. 
-	unsigned nlepton = 0;
-	auto lepp4 = fastjet::PseudoJet();
-	for ( auto icon = constituents.begin(); icon != constituents.end(); ++icon ) {
-	  auto const & py8part = pythia.event[ icon->user_index() ];
-	  if ( std::abs( py8part.id() ) > 10 && std::abs(py8part.id()) < 16){
+    for ( size_t icoll = 0; icoll < clusterer.size(); ++icoll ) {
+      JetColumns & jet = *rec.jetCollections[icoll];
+      std::vector<fastjet::PseudoJet> const & jets = clusterer.jets( icoll );
+      bool primary = icoll == 0;        // constituent_jetndx and _subjetndx refer to the first collection
+      if ( jets.size() > 0 ) {
+	auto ibegin = jets.begin();
+	auto iend = jets.end();
+	for ( auto ijet=ibegin;ijet!=iend;++ijet ) {
+	  if ( verbose ) std::cout << "processing jet " << ijet - ibegin << std::endl;
+
+	  auto constituents = ijet->constituents();
+
+	  // Remove jets that are comprised entirely of isolated leptons such as Z->ll:
+	  // we ignore jets with more than lepfrac (0.9) of their energy from leptons.
+	  bool accepted = substructure.accept( *ijet, constituents, particleId, verbose );
+	  st.lap( kJets );
+	  if ( !accepted ){
 	    if ( verbose ){
 	      char buff[1000];
-	      sprintf( buff, "  lepton  :  id=%6d  p4=(%6.4f,%6.2f,%6.2f,%6.4f)", py8part.id(), icon->pt(), icon->eta(), icon->phi(), icon->m() );
-	      std::cout << buff << std::endl; 	      
+	      sprintf( buff, "  skip jet:  ndx=%6d, nc=%6d  p4=(%6.4f,%6.2f,%6.2f,%6.4f)", ijet-ibegin, constituents.size(), ijet->pt(), ijet->eta(), ijet->phi(), ijet->m() );
+	      std::cout << buff << std::endl; 
 	    }
-	    lepp4 += *icon;
+	    continue;
 	  }
-	}
-	if ( lepp4.e() / ijet->e() > lepfrac){
-	  if ( verbose ){
+
+	  if ( verbose ) {
+	    std::cout << "getting constituents for jet :" << std::endl;
 	    char buff[1000];
-	    sprintf( buff, "  skip jet:  ndx=%6d, nc=%6d  p4=(%6.4f,%6.2f,%6.2f,%6.4f)", ijet-ibegin, constituents.size(), ijet->pt(), ijet->eta(), ijet->phi(), ijet->m() );
-	    std::cout << buff << std::endl; 
+	    sprintf( buff, "  add  jet:  ndx=%6d, nc=%6d  p4=(%6.4f,%6.2f,%6.2f,%6.4f)", ijet-ibegin, constituents.size(), ijet->pt(), ijet->eta(), ijet->phi(), ijet->m() );
+	    std::cout << buff << std::endl;
 	  }
-	  continue;
-	}
+	  if ( jet.size() < kMaxJet ) { 
+	    // Only the jets that are stored are groomed.
+	    substructure.groom( *ijet );
+	    auto const & sd_jet = sd.main();
+	    st.lap( kSoftDrop );
+	    Int_t nJet = jet.push();
+	    jet.pt[nJet]=ijet->perp();
+	    jet.eta[nJet]=ijet->eta();
+	    jet.phi[nJet]=ijet->phi();
+	    jet.m[nJet]=ijet->m();	  
+	    jet.msd[nJet] = sd_jet.m();
+	    st.lap( kJets );
+
+	    if ( schema.nsubjettiness && nJet < 20 ) { //N-jettiness is hard-coded to only allow up to 20 jets
+
+
+	      // tau_1 ... tau_8 for every beta_nsj using one-pass WTA KT axes,
+	      // on the ungroomed and then on the groomed jet.
+	      substructure.taus( *ijet, [&]( unsigned int N, unsigned int nsj_index, double tau ) { (*jet.tau[N-1])[nJet][nsj_index] = tau; } );
+	      substructure.taus( sd_jet, [&]( unsigned int N, unsigned int nsj_index, double tau ) { (*jet.tau_sd[N-1])[nJet][nsj_index] = tau; } );
 
-	if ( verbose ) {
-	  std::cout << "getting constituents for jet :" << std::endl;
-	  char buff[1000];
-	  sprintf( buff, "  add  jet:  ndx=%6d, nc=%6d  p4=(%6.4f,%6.2f,%6.2f,%6.4f)", ijet-ibegin, constituents.size(), ijet->pt(), ijet->eta(), ijet->phi(), ijet->m() );
-	  std::cout << buff << std::endl;
-	}
-	if ( nJet < kMaxJet ) { 
-	  
-	  jet_pt[nJet]=ijet->perp();
-	  jet_eta[nJet]=ijet->eta();
-	  jet_phi[nJet]=ijet->phi();
-	  jet_m[nJet]=ijet->m();	  
-	  jet_msd[nJet] = sd_jet.m();
-
-	  if ( nJet < 20 ) { //N-jettiness is hard-coded to only allow up to 20 jets
-
-
-	    // Define Nsubjettiness functions for beta = 1.0 using one-pass WTA KT axes
-
-	    
-	    for ( unsigned int nsj_index = 0; nsj_index < kMaxNsjBeta; ++nsj_index) {
-	      double beta_nsj = 0.5 + 0.5*nsj_index;
-	      const Int_t max_nsj = 8;
-
-	      fastjet::contrib::Nsubjettiness nSub1_beta1(1, fastjet::contrib::OnePass_WTA_KT_Axes(), fastjet::contrib::UnnormalizedMeasure(beta_nsj));
-	      fastjet::contrib::Nsubjettiness nSub2_beta1(2, fastjet::contrib::OnePass_WTA_KT_Axes(), fastjet::contrib::UnnormalizedMeasure(beta_nsj));
-	      fastjet::contrib::Nsubjettiness nSub3_beta1(3, fastjet::contrib::OnePass_WTA_KT_Axes(), fastjet::contrib::UnnormalizedMeasure(beta_nsj));
-	      fastjet::contrib::Nsubjettiness nSub4_beta1(4, fastjet::contrib::OnePass_WTA_KT_Axes(), fastjet::contrib::UnnormalizedMeasure(beta_nsj));
-	      fastjet::contrib::Nsubjettiness nSub5_beta1(5, fastjet::contrib::OnePass_WTA_KT_Axes(), fastjet::contrib::UnnormalizedMeasure(beta_nsj));
-	      fastjet::contrib::Nsubjettiness nSub6_beta1(6, fastjet::contrib::OnePass_WTA_KT_Axes(), fastjet::contrib::UnnormalizedMeasure(beta_nsj));
-	      fastjet::contrib::Nsubjettiness nSub7_beta1(7, fastjet::contrib::OnePass_WTA_KT_Axes(), fastjet::contrib::UnnormalizedMeasure(beta_nsj));
-	      fastjet::contrib::Nsubjettiness nSub8_beta1(8, fastjet::contrib::OnePass_WTA_KT_Axes(), fastjet::contrib::UnnormalizedMeasure(beta_nsj));
-
-	      jet_tau1[nJet][nsj_index] = nSub1_beta1(*ijet);
-	      jet_tau2[nJet][nsj_index] = nSub2_beta1(*ijet);
-	      jet_tau3[nJet][nsj_index] = nSub3_beta1(*ijet);
-	      jet_tau4[nJet][nsj_index] = nSub4_beta1(*ijet);
-	      jet_tau5[nJet][nsj_index] = nSub5_beta1(*ijet);
-	      jet_tau6[nJet][nsj_index] = nSub6_beta1(*ijet);
-	      jet_tau7[nJet][nsj_index] = nSub7_beta1(*ijet);
-	      jet_tau8[nJet][nsj_index] = nSub8_beta1(*ijet);
-
-	      jet_tau1_sd[nJet][nsj_index] = nSub1_beta1(sd_jet);
-	      jet_tau2_sd[nJet][nsj_index] = nSub2_beta1(sd_jet);
-	      jet_tau3_sd[nJet][nsj_index] = nSub3_beta1(sd_jet);
-	      jet_tau4_sd[nJet][nsj_index] = nSub4_beta1(sd_jet);
-	      jet_tau5_sd[nJet][nsj_index] = nSub5_beta1(sd_jet);
-	      jet_tau6_sd[nJet][nsj_index] = nSub6_beta1(sd_jet);
-	      jet_tau7_sd[nJet][nsj_index] = nSub7_beta1(sd_jet);
-	      jet_tau8_sd[nJet][nsj_index] = nSub8_beta1(sd_jet);
 	    }
-
-	  }
-	  
-	  jet_nc[nJet] = constituents.size();
-	  auto subjets = sd_jet.pieces();
-	  
-	  jet_nsubjet[nJet] = subjets.size(); 
-	  std::vector<fastjet::PseudoJet> sj0_pieces, sj1_pieces; 
-
-	  if ( subjets.size() >= 1 ) {
-	    jet_subjet0_pt[nJet]  = subjets[0].perp();
-	    jet_subjet0_eta[nJet] = subjets[0].eta();
-	    jet_subjet0_phi[nJet] = subjets[0].phi();
-	    jet_subjet0_m[nJet]   = subjets[0].m();	    
-	    auto ipieces = subjets[0].constituents();
-	    sj0_pieces.insert( sj0_pieces.begin(), ipieces.begin(), ipieces.end() );
-	  }
-	  if ( subjets.size() >= 2 ) {
-	    jet_subjet1_pt[nJet]  = subjets[1].perp();
-	    jet_subjet1_eta[nJet] = subjets[1].eta();
-	    jet_subjet1_phi[nJet] = subjets[1].phi();
-	    jet_subjet1_m[nJet]   = subjets[1].m();
-	    auto ipieces = subjets[1].constituents();
-	    sj1_pieces.insert( sj1_pieces.begin(), ipieces.begin(), ipieces.end() );
-	  } else{
-	    jet_subjet1_pt[nJet]  = 0;
-	    jet_subjet1_eta[nJet] = 0;
-	    jet_subjet1_phi[nJet] = 0;
-	    jet_subjet1_m[nJet]   = 0;
-	  }
-	  if ( constituents.size() > 0 ) {	    
-	    auto jbegin = constituents.begin();
-	    auto jend = constituents.end();
-	    Int_t nParticle = 0;
-	    for ( auto iparticle=jbegin; iparticle != jend;++iparticle ){
-	      
-	      auto index = iparticle->user_index();
-	      jet_ic[nJet][nParticle] = constituentmap[index];
-	      constituent_jetndx[constituentmap[index]] = nJet;
-	      
-	      auto sj0_find = std::find_if( sj0_pieces.begin(), sj0_pieces.end(), CompareIndex(*iparticle) );
-	      auto sj1_find = std::find_if( sj1_pieces.begin(), sj1_pieces.end(), CompareIndex(*iparticle) );
-	      if ( sj0_find != sj0_pieces.end() ){
-		constituent_subjetndx[constituentmap[index]]=0;
-	      } else if ( sj1_find != sj1_pieces.end() ) {
-		constituent_subjetndx[constituentmap[index]]=1;
-	      } else {
-		constituent_subjetndx[constituentmap[index]]=-1;
+	    st.lap( kNsubjettiness );
+
+	    jet.nc[nJet] = constituents.size();
+	    jet.nic[nJet] = schema.constituents ? constituents.size() : 0;
+	    auto subjets = schema.subjets ? sd_jet.pieces() : std::vector<fastjet::PseudoJet>();
+
+	    jet.nsubjet[nJet] = subjets.size(); 
+
+	    if ( subjets.size() >= 1 ) {
+	      jet.subjet0_pt[nJet]  = subjets[0].perp();
+	      jet.subjet0_eta[nJet] = subjets[0].eta();
+	      jet.subjet0_phi[nJet] = subjets[0].phi();
+	      jet.subjet0_m[nJet]   = subjets[0].m();	    
+	    } else {
+	      jet.subjet0_pt[nJet]  = 0;
+	      jet.subjet0_eta[nJet] = 0;
+	      jet.subjet0_phi[nJet] = 0;
+	      jet.subjet0_m[nJet]   = 0;
+	    }
+	    if ( subjets.size() >= 2 ) {
+	      jet.subjet1_pt[nJet]  = subjets[1].perp();
+	      jet.subjet1_eta[nJet] = subjets[1].eta();
+	      jet.subjet1_phi[nJet] = subjets[1].phi();
+	      jet.subjet1_m[nJet]   = subjets[1].m();
+	    } else{
+	      jet.subjet1_pt[nJet]  = 0;
+	      jet.subjet1_eta[nJet] = 0;
+	      jet.subjet1_phi[nJet] = 0;
+	      jet.subjet1_m[nJet]   = 0;
+	    }
+	    // The same at every scan point.
+	    for ( size_t ip = 0; ip < sd.nScan(); ++ip ) {
+	      auto const & groomed = sd.scanned( ip );
+	      (*jet.sdscan.msd)[nJet][ip] = groomed.m();
+	      auto pieces = schema.subjets ? groomed.pieces() : std::vector<fastjet::PseudoJet>();
+	      (*jet.sdscan.nsubjet)[nJet][ip] = pieces.size();
+	      for ( unsigned int isj = 0; isj < 2; ++isj ) {
+		auto & subjet = isj == 0 ? jet.sdscan.subjet0 : jet.sdscan.subjet1;
+		bool found = pieces.size() > isj;
+		(*subjet[0])[nJet][ip] = found ? pieces[isj].perp() : 0;
+		(*subjet[1])[nJet][ip] = found ? pieces[isj].eta() : 0;
+		(*subjet[2])[nJet][ip] = found ? pieces[isj].phi() : 0;
+		(*subjet[3])[nJet][ip] = found ? pieces[isj].m() : 0;
+	      }
+	    }
+	    st.lap( kJets );
+	    if ( schema.nsubjettiness && nJet < 20 ) {
+	      for ( size_t ip = 0; ip < sd.nScan(); ++ip ) {
+		substructure.taus( sd.scanned( ip ), [&]( unsigned int N, unsigned int nsj_index, double tau ) { (*jet.sdscan.tau[N-1])[nJet][ip][nsj_index] = tau; } );
 	      }
-	      if ( verbose ) std::cout << index << " ";
-	      ++nParticle;
 	    }
-	    if ( verbose) std::cout << endl;
+	    st.lap( kNsubjettiness );
+	    if ( cfg.tensors.enabled() ) {
+	      rasterizer.fill( *ijet, constituents, sd_jet, clusterer.spec( icoll ).R,
+			       jet.image ? (*jet.image)[nJet] : nullptr, jet.cloud ? (*jet.cloud)[nJet] : nullptr );
+	      st.lap( kTensors );
+	    }
+	    // Tag the constituents of the two leading subjets. Subjets do not overlap and
+	    // constituent_subjetndx starts out at -1, so one pass over the pieces is enough.
+	    for ( unsigned int isj = 0; primary && schema.constituents && isj < 2 && isj < subjets.size(); ++isj ) {
+	      for ( auto const & piece : subjets[isj].constituents() ) {
+		constituent.subjetndx[constituentIndex[piece.user_index()]] = isj;
+	      }
+	    }
+	    if ( schema.constituents && constituents.size() > 0 ) {	    
+	      auto jbegin = constituents.begin();
+	      auto jend = constituents.end();
+	      for ( auto iparticle=jbegin; iparticle != jend;++iparticle ){
+
+		auto index = iparticle->user_index();
+		jet.ic[jet.ics.push()] = constituentIndex[index];
+		if ( primary ) constituent.jetndx[constituentIndex[index]] = nJet;
+		if ( verbose ) std::cout << index << " ";
+	      }
+	      if ( verbose) std::cout << endl;
+	    }
+	    st.lap( kConstituents );
+	  } else {
+	    slot.truncated = true;
 	  }
-	  ++nJet;
 	}
       }
+      if ( jet.size() > 0 && jet.pt[0] > clusterer.spec( icoll ).ptmin ) slot.stored = true;
+    }
+    // Drop the constituents that no stored jet refers to.
+    if ( cfg.skimPtmin >= 0. && schema.constituents && slot.stored ) {
+      rec.skimConstituents( cfg.skimPtmin );
+      st.lap( kConstituents );
+    }
+    return true;
+  };
+
+  // Write the events in the order they were generated, and keep count.
+  auto writeStage = [&]( EventSlot & slot ) {
+    stats.skip();
+    if ( slot.generated ) ++stats.generated;
+    else ++stats.aborted;
+    if ( slot.stored ) {
       if ( verbose ) 
 	std::cout << "About to write" << std::endl;
-      if ( nJet > 0 && jet_pt[0] > ptmin ) {
-	// Fill the pythia event into the TTree.
-	T->Fill();
+      // Fill the pythia event into the TTree.
+      if ( asyncWriter ) {
+	asyncWriter->submit();
+      } else {
+	if ( slot.rec != &booked ) booked.copyFrom( *slot.rec );
+	fillOutput();
       }
+      stats.lap( kFill );
+      ++stats.accepted;
+      if ( slot.truncated ) ++stats.truncated;
       if ( verbose ) 
 	std::cout << "Done writing." << std::endl;
-    } // end check if jets.size() > 0
-  // End event loop.
-  }
+    }
+    if ( slot.audited && slot.kept ) partonVeto->recordAudit( slot.stored );
+    if ( stats.progressDue() ) {
+      std::lock_guard<std::mutex> lock( stdoutMutex );
+      stats.printProgress( std::cout, label );
+    }
+    return true;
+  };
+
+ // Begin event loop. Generate event; skip if generation aborted.
+  Pipeline<EventSlot> pipeline( { "generate", "jets", "write" }, { generateStage, jetStage, writeStage }, slots, cfg.pipelineSlots > 0 );
+  stats.start();
+  for ( auto & st : stageStats ) st.start();
+  pipeline.run();
+  //  Write tree, or commit the last RNTuple cluster of this worker.
+  if ( asyncWriter ) asyncWriter->finish();
+  if ( ntupleFiller ) ntupleFiller.reset();
+  else if ( arrowFiller ) arrowFiller.reset();             // writes the last row group
+  else if ( merged ) file->Write();
+  else if ( cfg.checkpointEvery > 0 || cfg.resume ) T->Write( "", TObject::kOverwrite );   // replace the AutoSaved tree
+  else T->Write();
+  // DO NOT delete T. 
+  stats.lap( kFill );
+  weights = WeightSummary::from( io.cacheIn ? nullptr : &pythia.info, unweighter );
 
   // Statistics on event generation.
-  pythia.stat();
+  {
+    std::lock_guard<std::mutex> lock( stdoutMutex );
+    if ( !io.cacheIn ) pythia.stat();
+    if ( partonVeto ) partonVeto->print( std::cout );
+    unweighter.print( std::cout );
+    generator.print( std::cout );
+    std::cout << " Output (" << cfg.format << "): " << stats.accepted << " entries, " << stats.seconds( kFill ) << " s in the writer" << std::endl;
+    if ( asyncWriter ) asyncWriter->print( std::cout );
+    pipeline.print( std::cout );
+  }
+  for ( auto const & st : stageStats ) stats.merge( st );
+  return true;
+}
 
-  //  Write tree.
-  T->Write();
-  file->Close();
-  // DO NOT delete T. 
+int main(int argc, char ** argv) {
+
+  RunConfig cfg;
+
+  // Strip the "--option value" switches, leaving the positional arguments.
+  // The branch tuning is put together afterwards: the preset first, then the groups.
+  std::vector<char *> args;
+  std::string tuningPreset = "default";
+  std::vector<std::pair<std::string, std::string> > tuningOptions;
+  bool jetRGiven = false;
+  for ( int i = 0; i < argc; ++i ) {
+    std::string arg( argv[i] );
+    bool ok = true;
+    if ( cfg.parse( i, argc, argv, ok ) ) {
+      if ( !ok ) return 1;
+    } else if ( arg == "--threads" && i + 1 < argc ) {
+      cfg.nThreads = std::max( 1, atoi( argv[++i] ) );
+    } else if ( arg == "--parton-veto" && i + 1 < argc ) {
+      cfg.vetoMargin = atof( argv[++i] );
+    } else if ( arg == "--veto-audit" && i + 1 < argc ) {
+      cfg.vetoAuditEvery = atol( argv[++i] );
+    } else if ( arg == "--async-write" && i + 1 < argc ) {
+      cfg.writerSlots = std::max( 0, atoi( argv[++i] ) );
+    } else if ( arg == "--imt" && i + 1 < argc ) {
+      cfg.imtThreads = std::max( 0, atoi( argv[++i] ) );
+    } else if ( arg == "--compression" && i + 1 < argc ) {
+      tuningPreset = argv[++i];
+    } else if ( arg == "--branch-compression" && i + 1 < argc ) {
+      tuningOptions.emplace_back( "compression", argv[++i] );
+    } else if ( arg == "--basket-size" && i + 1 < argc ) {
+      tuningOptions.emplace_back( "basket", argv[++i] );
+    } else if ( arg == "--precision" && i + 1 < argc ) {
+      tuningOptions.emplace_back( "precision", argv[++i] );
+    } else if ( arg == "--auto-flush" && i + 1 < argc ) {
+      cfg.tuning.autoFlush = atol( argv[++i] );
+    } else if ( arg == "--format" && i + 1 < argc ) {
+      cfg.format = argv[++i];
+    } else if ( arg == "--row-group" && i + 1 < argc ) {
+      cfg.arrow.rowGroup = std::max( 1L, atol( argv[++i] ) );
+    } else if ( arg == "--arrow-compression" && i + 1 < argc ) {
+      if ( !cfg.arrow.parseCompression( argv[++i] ) ) return 1;
+    } else if ( arg == "--arrow-dictionary" && i + 1 < argc ) {
+      cfg.arrow.dictionary = std::string( argv[++i] ) != "off";
+    } else if ( arg == "--write-cache" && i + 1 < argc ) {
+      cfg.cacheOut = argv[++i];
+    } else if ( arg == "--from-cache" && i + 1 < argc ) {
+      cfg.cacheIn = argv[++i];
+    } else if ( arg == "--shm" && i + 1 < argc ) {
+      cfg.shmName = argv[++i];
+    } else if ( arg == "--shm-slots" && i + 1 < argc ) {
+      cfg.shmSlots = atol( argv[++i] );
+    } else if ( arg == "--shm-slot-bytes" && i + 1 < argc ) {
+      cfg.shmSlotBytes = atol( argv[++i] );
+    } else if ( arg == "--shm-policy" && i + 1 < argc ) {
+      cfg.shmPolicy = argv[++i];
+    } else if ( arg == "--jet-R" && i + 1 < argc ) {
+      cfg.R = atof( argv[++i] );
+      jetRGiven = true;
+    } else if ( arg == "--lepfrac" && i + 1 < argc ) {
+      cfg.lepfrac = atof( argv[++i] );
+    } else if ( arg == "--sd-zcut" && i + 1 < argc ) {
+      cfg.sdZcut = atof( argv[++i] );
+    } else if ( arg == "--sd-beta" && i + 1 < argc ) {
+      cfg.sdBeta = atof( argv[++i] );
+    } else if ( arg == "--unweight" && i + 1 < argc ) {
+      cfg.unweight = atof( argv[++i] );
+    } else if ( arg == "--checkpoint" && i + 1 < argc ) {
+      cfg.checkpointEvery = atol( argv[++i] );
+    } else if ( arg == "--resume" ) {
+      cfg.resume = true;
+    } else if ( arg == "--skim-constituents" && i + 1 < argc ) {
+      cfg.skimPtmin = std::max( 0., atof( argv[++i] ) );
+    } else if ( arg == "--jet-images" && i + 1 < argc ) {
+      cfg.tensors.shape.npix = std::max( 0, atoi( argv[++i] ) );
+    } else if ( arg == "--particle-cloud" && i + 1 < argc ) {
+      cfg.tensors.shape.ncloud = std::max( 0, atoi( argv[++i] ) );
+    } else if ( arg == "--tensor-centre" && i + 1 < argc ) {
+      if ( !cfg.tensors.parseCentre( argv[++i] ) ) return 1;
+    } else if ( arg == "--tensor-rotate" && i + 1 < argc ) {
+      cfg.tensors.rotate = std::string( argv[++i] ) != "off";
+    } else if ( arg == "--tensor-normalize" && i + 1 < argc ) {
+      cfg.tensors.normalize = std::string( argv[++i] ) != "off";
+    } else if ( arg == "--drop" && i + 1 < argc ) {
+      if ( !OutputSchema::dropCommands( argv[++i], cfg.schemaCommands ) ) return 1;
+    } else {
+      args.push_back( argv[i] );
+    }
+  }
+
+  if ( !cfg.positional( args ) ) {
+    std::cout << "usage: " << args[0] << " [--threads N] [--parton-veto margin] [--veto-audit n] [--drop group,...] [--skim-constituents ptmin] [--jet-images npix] [--particle-cloud n] [--tensor-centre axis|subjet] [--tensor-rotate on|off] [--tensor-normalize on|off] [--format tree|rntuple|parquet|arrow] [--row-group n] [--arrow-compression codec[:level]] [--arrow-dictionary on|off] [--compression default|fast|balanced|archive|compact] [--branch-compression group=algo:level,...] [--basket-size group=bytes,...] [--precision group=bits,...] [--auto-flush n] [--async-write slots] [--imt N] [--write-cache file | --from-cache file] [--shm name [--shm-slots n] [--shm-slot-bytes b] [--shm-policy block|drop|overwrite]] [--jet-R r] [--lepfrac f] [--sd-zcut z] [--sd-beta b] [--unweight target_weight] [--checkpoint n] [--resume] " << CommonOptions::usage() << " config_file root_file n_events <optional: seed (-1 = default, 0=use time, or input your own)> <optional: ptcut>" << std::endl;
+    return 0;
+  }
+  const char * outfile = cfg.outfile.c_str();
+  // --jets gives R and ptmin of every collection, so they would be ignored.
+  if ( !cfg.jets.empty() && ( jetRGiven || args.size() > 5 ) ) {
+    std::cout << "--jets sets R and ptmin of every collection; leave out --jet-R and the ptcut argument" << std::endl;
+    return 1;
+  }
+  if ( args.size() > 5 ) {
+    cfg.ptmin = atof( args[5]);
+  }
+  if ( cfg.jets.empty() ) cfg.jets.push_back( JetSpec{ "jet", fastjet::antikt_algorithm, cfg.R, cfg.ptmin } );
+
+  if ( cfg.format != "tree" && cfg.format != "rntuple" && cfg.format != "parquet" && cfg.format != "arrow" ) {
+    std::cout << "unknown output format " << cfg.format << ", use tree, rntuple, parquet or arrow" << std::endl;
+    return 1;
+  }
+#ifndef GENJETS_HAVE_RNTUPLE
+  if ( cfg.format == "rntuple" ) {
+    std::cout << "--format rntuple needs ROOT 6.32 or later" << std::endl;
+    return 1;
+  }
+#endif
+  bool arrowFormat = cfg.format == "parquet" || cfg.format == "arrow";
+#ifndef GENJETS_HAVE_ARROW_OUTPUT
+  if ( arrowFormat ) {
+    std::cout << "--format " << cfg.format << " needs pythia2root built with the Arrow and Parquet libraries" << std::endl;
+    return 1;
+  }
+#endif
+  if ( !cfg.tuning.preset( tuningPreset ) ) return 1;
+  for ( auto const & option : tuningOptions ) if ( !cfg.tuning.parse( option.first, option.second ) ) return 1;
+  if ( tuningPreset != "default" || !tuningOptions.empty() || cfg.tuning.autoFlush != 0 ) cfg.tuning.print( std::cout );
+  // The runs and SoftDrop-scan bookkeeping trees go next to a Parquet or Arrow file.
+  std::string runsFile = arrowFormat ? std::string( outfile ) + ".runs.root" : std::string( outfile );
+  // Only a single plain tree can be flushed and reopened for appending.
+  if ( ( cfg.checkpointEvery > 0 || cfg.resume ) && ( cfg.format != "tree" || cfg.nThreads > 1 || cfg.writerSlots > 0 || cfg.pipelineSlots > 0 ) ) {
+    std::cout << "--checkpoint and --resume need --format tree, one thread and no --async-write or --pipeline" << std::endl;
+    return 1;
+  }
+  if ( cfg.writerSlots > 0 && cfg.pipelineSlots > 0 ) {
+    std::cout << "--pipeline already writes on its own thread; leave out --async-write" << std::endl;
+    return 1;
+  }
+  if ( cfg.resume && cfg.cacheOut != "" ) {
+    std::cout << "--resume cannot append to a --write-cache file" << std::endl;
+    return 1;
+  }
+  if ( cfg.firstEvent > 0 && cfg.cacheIn != "" ) {
+    std::cout << "--first-event is for generation; --from-cache keeps the event numbers of the cache" << std::endl;
+    return 1;
+  }
+  cfg.resolveEventSeed();
+  Checkpoint resume;
+  if ( cfg.resume ) {
+    if ( !resume.read( Checkpoint::filename( outfile ) ) ) return 1;
+    if ( resume.config != cfg.configfile || resume.seed != cfg.seed ) {
+      std::cout << "The checkpoint is for " << resume.config << " with seed " << resume.seed << ", not this run" << std::endl;
+      return 1;
+    }
+    std::cout << "Resuming " << outfile << " at event " << resume.nextEvent << std::endl;
+  }
+
+  // The writer threads and implicit MT both need ROOT's thread safety.
+  if ( cfg.nThreads > 1 || cfg.writerSlots > 0 || cfg.pipelineSlots > 0 || cfg.imtThreads > 0 ) ROOT::EnableThreadSafety();
+  if ( cfg.imtThreads > 0 ) ROOT::EnableImplicitMT( cfg.imtThreads );
+
+  // Particle cache to write, or to recluster instead of generating.
+  SharedIO io;
+  std::unique_ptr<ParticleCacheWriter> cacheOut;
+  std::unique_ptr<ParticleCacheReader> cacheIn;
+  if ( cfg.cacheIn != "" ) {
+    cacheIn.reset( new ParticleCacheReader( cfg.cacheIn ) );
+    if ( !cacheIn->good() ) return 1;
+    io.cacheIn = cacheIn.get();
+  } else if ( cfg.cacheOut != "" ) {
+    cacheOut.reset( new ParticleCacheWriter( cfg.cacheOut ) );
+    if ( !cacheOut->good() ) return 1;
+    io.cacheOut = cacheOut.get();
+  }
+  if ( cfg.resume ) io.resume = &resume;
+  // Shared-memory ring for online consumers, next to the output file.
+  std::unique_ptr<EventRingWriter> ring;
+  if ( cfg.shmName != "" ) {
+    EventRingWriter::Policy policy;
+    if ( !EventRingWriter::parsePolicy( cfg.shmPolicy, policy ) ) return 1;
+    if ( cfg.shmName[0] != '/' ) cfg.shmName = "/" + cfg.shmName;
+    ring.reset( new EventRingWriter( cfg.shmName, cfg.shmSlots, cfg.shmSlotBytes, policy ) );
+    if ( !ring->good() ) return 1;
+    io.ring = ring.get();
+  }
+
+  std::mutex stdoutMutex;
+  std::vector<RunStats> stats( cfg.nThreads, RunStats( stageNames, cfg.reportEvery ) );
+  std::vector<WeightSummary> weights( cfg.nThreads );
+  auto wallStart = RunStats::Clock::now();
+  if ( cfg.format == "rntuple" ) {
+    // All workers fill the same RNTuple, each through its own fill context.
+    GenJetsNTupleFile ntuple( outfile );
+#ifdef GENJETS_HAVE_RNTUPLE
+    if ( cfg.tuning.fileCompression() >= 0 ) ntuple.options().SetCompression( cfg.tuning.fileCompression() );
+#endif
+    io.ntuple = &ntuple;
+    std::vector<std::thread> workers;
+    for ( unsigned int iworker = 0; iworker < cfg.nThreads; ++iworker ) {
+      workers.emplace_back( [&, iworker]() { runWorker( cfg, iworker, nullptr, false, io, stats[iworker], weights[iworker], stdoutMutex ); } );
+    }
+    for ( auto & worker : workers ) worker.join();
+    ntuple.close();
+  } else if ( arrowFormat ) {
+    // All workers append row groups to the same file.
+    GenJetsArrowFile arrowFile( outfile, cfg.format == "parquet", cfg.arrow );
+    io.arrow = &arrowFile;
+    std::vector<std::thread> workers;
+    for ( unsigned int iworker = 0; iworker < cfg.nThreads; ++iworker ) {
+      workers.emplace_back( [&, iworker]() { runWorker( cfg, iworker, nullptr, false, io, stats[iworker], weights[iworker], stdoutMutex ); } );
+    }
+    for ( auto & worker : workers ) worker.join();
+    arrowFile.close();
+  } else if ( cfg.nThreads == 1 ) {
+    // Set up the ROOT TFile.
+    TFile *file = TFile::Open(outfile, cfg.resume ? "update" : "recreate");
+    if ( cfg.tuning.fileCompression() >= 0 ) file->SetCompressionSettings( cfg.tuning.fileCompression() );
+    bool done = runWorker( cfg, 0, file, false, io, stats[0], weights[0], stdoutMutex );
+    file->Close();
+    if ( !done ) return 1;
+  } else {
+    // Each worker owns a Pythia instance and fills its own in-memory file;
+    // the merger streams those into the single output tree.
+    ROOT::TBufferMerger merger( outfile, "recreate", cfg.tuning.fileCompression() >= 0 ? cfg.tuning.fileCompression() : int( ROOT::RCompressionSetting::EDefaults::kUseCompiledDefault ) );
+    std::vector<std::thread> workers;
+    for ( unsigned int iworker = 0; iworker < cfg.nThreads; ++iworker ) {
+      workers.emplace_back( [&, iworker]() {
+	  auto file = merger.GetFile();
+	  runWorker( cfg, iworker, file.get(), true, io, stats[iworker], weights[iworker], stdoutMutex );
+	} );
+    }
+    for ( auto & worker : workers ) worker.join();
+  }
+  if ( cacheOut ) cacheOut->close();
+  if ( ring ) {
+    ring->close();
+    ring->print( std::cout );
+  }
+  // The output file is complete by now; add the cross-section bookkeeping to it,
+  // including the segments of the run before it was resumed.
+  if ( cfg.resume ) weights.insert( weights.begin(), resume.segments.begin(), resume.segments.end() );
+  WeightSummary::print( std::cout, weights );
+  WeightSummary::write( runsFile, weights );
+  if ( !cfg.sdScan.empty() ) SoftDropScanOutput::write( runsFile, cfg.sdScan );
+  if ( cfg.checkpointEvery > 0 || cfg.resume ) Checkpoint::remove( Checkpoint::filename( outfile ) );
+  double wallSeconds = std::chrono::duration<double>( RunStats::Clock::now() - wallStart ).count();
+
+  // Where the time went, summed over the workers.
+  for ( unsigned int iworker = 1; iworker < cfg.nThreads; ++iworker ) stats[0].merge( stats[iworker] );
+  stats[0].print( std::cout );
+  stats[0].writeJson( cfg.statsFile, "pythia2root", cfg.configfile, cfg.nThreads, wallSeconds );
 
   // Done.
   return 0;
@@ -0,0 +1,95 @@
+// ringconsumer.cc
+// Reference consumer of pythia2root --shm: reads the events from the
+// shared-memory ring as they are generated and prints, every n events, the
+// rate, the events lost or dropped, and the mean number and leading pt of
+// the jets. At the end it prints a histogram of the leading jet pt.
+//
+// usage: ./ringconsumer name [--every n] [--max-events n] [--timeout s] [--prefix jet]
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "EventRing.h"
+
+// Ctrl-C or kill end the read loop, so that the summary is printed and the
+// consumer detaches instead of holding up the producer's ring.
+static EventRingReader * gReader = nullptr;
+
+static void stopReading( int ) {
+  if ( gReader ) gReader->interrupt();
+}
+
+int main( int argc, char * argv[] ) {
+  std::vector<char *> args;
+  unsigned long every = 1000, maxEvents = 0;
+  double timeout = -1.;
+  std::string prefix = "jet";
+  for ( int i = 0; i < argc; ++i ) {
+    std::string arg( argv[i] );
+    if ( arg == "--every" && i + 1 < argc ) every = std::atol( argv[++i] );
+    else if ( arg == "--max-events" && i + 1 < argc ) maxEvents = std::atol( argv[++i] );
+    else if ( arg == "--timeout" && i + 1 < argc ) timeout = std::atof( argv[++i] );
+    else if ( arg == "--prefix" && i + 1 < argc ) prefix = argv[++i];
+    else args.push_back( argv[i] );
+  }
+  if ( args.size() < 2 ) {
+    std::cout << "usage: " << args[0] << " [--every n] [--max-events n] [--timeout s] [--prefix jet] name" << std::endl;
+    return 0;
+  }
+  std::string name = args[1];
+  if ( name[0] != '/' ) name = "/" + name;
+
+  EventRingReader reader( name, timeout < 0 ? 60. : timeout );
+  if ( !reader.good() ) return 1;
+  gReader = &reader;
+  std::signal( SIGINT, stopReading );
+  std::signal( SIGTERM, stopReading );
+  std::cout << "Reading " << name << ":";
+  for ( auto const & column : reader.columns() ) std::cout << " " << column;
+  std::cout << std::endl;
+
+  // Leading jet pt in 20 GeV bins up to 2 TeV.
+  const int nBins = 100;
+  const double binWidth = 20.;
+  std::vector<unsigned long> hist( nBins + 1, 0 );
+  EventRingEvent ev;
+  unsigned long nEvents = 0, nJets = 0;
+  double sumLeadingPt = 0.;
+  auto start = std::chrono::steady_clock::now();
+  auto last = start;
+  while ( ( maxEvents == 0 || nEvents < maxEvents ) && reader.next( ev, timeout ) ) {
+    ++nEvents;
+    int n = 0;
+    float const * pt = ev.column<float>( prefix + "_pt", n );
+    nJets += n;
+    if ( pt && n > 0 ) {
+      sumLeadingPt += pt[0];
+      ++hist[ std::min( nBins, int( pt[0] / binWidth ) ) ];
+    }
+    if ( every > 0 && nEvents % every == 0 ) {
+      auto now = std::chrono::steady_clock::now();
+      char buff[1000];
+      sprintf( buff, "%10lu events  %9.1f events/s  lost %lu  dropped %lu  <n%s> %.2f  <leading pt> %.1f",
+	       nEvents, every / std::chrono::duration<double>( now - last ).count(), (unsigned long)reader.lost(),
+	       (unsigned long)reader.dropped(), prefix.c_str(), double( nJets ) / nEvents, sumLeadingPt / nEvents );
+      std::cout << buff << std::endl;
+      last = now;
+    }
+  }
+  double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+  std::cout << nEvents << " events in " << seconds << " s, " << reader.lost() << " lost" << std::endl;
+  std::cout << "Leading " << prefix << " pt:" << std::endl;
+  for ( int i = 0; i <= nBins; ++i ) {
+    if ( hist[i] == 0 ) continue;
+    char buff[1000];
+    if ( i < nBins ) sprintf( buff, "  %6.0f - %6.0f  %10lu", i * binWidth, ( i + 1 ) * binWidth, hist[i] );
+    else sprintf( buff, "  %6.0f -         %10lu", i * binWidth, hist[i] );
+    std::cout << buff << std::endl;
+  }
+  return 0;
+}